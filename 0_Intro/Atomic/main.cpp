@@ -4,10 +4,13 @@
  * @copyright BSD-3-Clause
  */
 
-#define __CL_ENABLE_EXCEPTIONS
-#include <CL/cl.hpp>
+#include "pzcl_device_pool.hpp"
+#include "radix_sort.hpp"
+#include <algorithm>
 #include <cassert>
-#include <fstream>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <iostream>
 #include <omp.h>
 #include <random>
@@ -34,81 +37,36 @@ void cpuAtomicAdd(size_t num, const std::vector<double>& src, double& dst)
     }
 }
 
-inline size_t getFileSize(std::ifstream& file)
-{
-    file.seekg(0, std::ios::end);
-    size_t ret = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    return ret;
-}
-
-inline void loadFile(std::ifstream& file, std::vector<char>& d, size_t size)
-{
-    d.resize(size);
-    file.read(reinterpret_cast<char*>(d.data()), size);
-}
-
-cl::Program createProgram(cl::Context& context, const std::vector<cl::Device>& devices, const std::string& filename)
-{
-    std::ifstream file;
-    file.open(filename, std::ios::in | std::ios::binary);
-
-    if (file.fail()) {
-        throw "can not open kernel file";
-    }
-
-    size_t            filesize = getFileSize(file);
-    std::vector<char> binary_data;
-    loadFile(file, binary_data, filesize);
-
-    cl::Program::Binaries binaries;
-    binaries.push_back(std::make_pair(&binary_data[0], filesize));
-
-    return cl::Program(context, devices, binaries, nullptr, nullptr);
-}
-
-cl::Program createProgram(cl::Context& context, const cl::Device& device, const std::string& filename)
-{
-    std::vector<cl::Device> devices { device };
-    return createProgram(context, devices, filename);
-}
-
-void pzcAtomicAdd(size_t num, const std::vector<double>& src, double& dst)
+// Runs kernel_name ("atomic_add" or "atomic_add_hierarchical") over the
+// first num elements of src and returns the kernel time in milliseconds.
+double pzcAtomicAdd(const std::string& kernel_name, size_t num, const std::vector<double>& src, double& dst)
 {
     try {
-        // Get Platform
-        std::vector<cl::Platform> platforms;
-        cl::Platform::get(&platforms);
-        const auto& Platform = platforms[0];
-
-        // Get devices
-        std::vector<cl::Device> devices;
-        Platform.getDevices(CL_DEVICE_TYPE_DEFAULT, &devices);
-
-        // Use first device.
-        const auto& device = devices[0];
-
-        // Create Context.
-        auto context = cl::Context(device);
-
-        // Create CommandQueue.
-        auto command_queue = cl::CommandQueue(context, device, 0);
-
-        // Create Program.
-        // Load compiled binary file and create cl::Program object.
-        auto program = createProgram(context, device, "kernel/kernel.pz");
+        // Check out Context, CommandQueue (enable profiling) and Program
+        // of first device. Only the first call creates them, later calls
+        // reuse them.
+        auto  device        = pzcl::DevicePool::instance().checkout(0, "kernel/kernel.pz", CL_QUEUE_PROFILING_ENABLE);
+        auto& command_queue = device->queue;
 
-        // Create Kernel.
+        // Get Kernel.
         // Give kernel name without pzc_ prefix.
-        auto kernel = cl::Kernel(program, "atomic_add");
+        auto& kernel = device->kernel(kernel_name);
 
-        // Create Buffers.
-        auto device_src = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(double) * num);
-        auto device_dst = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(double));
+        // Get Buffers.
+        // They go back to the pool of the device at the end of the call.
+        auto  pooled_src = device->buffers->acquire(sizeof(double) * std::max<size_t>(num, 1));
+        auto  pooled_dst = device->buffers->acquire(sizeof(double));
+        auto& device_src = pooled_src.get();
+        auto& device_dst = pooled_dst.get();
 
         // Send src.
-        command_queue.enqueueWriteBuffer(device_src, true, 0, sizeof(double) * num, &src[0]);
+        if (num > 0) {
+            command_queue.enqueueWriteBuffer(device_src, true, 0, sizeof(double) * num, &src[0]);
+        }
+
+        // Clear dst. The kernels add to it.
+        const double zero = 0.0;
+        command_queue.enqueueWriteBuffer(device_dst, true, 0, sizeof(double), &zero);
 
         // Set kernel args.
         kernel.setArg(0, device_src);
@@ -116,24 +74,7 @@ void pzcAtomicAdd(size_t num, const std::vector<double>& src, double& dst)
         kernel.setArg(2, num);
 
         // Get workitem size.
-        // sc1-64: 8192  (1024 PEs * 8 threads)
-        // sc2   : 15782 (1984 PEs * 8 threads)
-        size_t global_work_size = 0;
-        {
-            std::string device_name;
-            device.getInfo(CL_DEVICE_NAME, &device_name);
-
-            size_t global_work_size_[3] = { 0 };
-            device.getInfo(CL_DEVICE_MAX_WORK_ITEM_SIZES, &global_work_size_);
-
-            global_work_size = global_work_size_[0];
-            if (device_name.find("PEZY-SC2") != std::string::npos) {
-                global_work_size = std::min(global_work_size, (size_t)15872);
-            }
-
-            std::cout << "Use device : " << device_name << std::endl;
-            std::cout << "workitem   : " << global_work_size << std::endl;
-        }
+        const size_t global_work_size = device->global_work_size;
 
         // Run device kernel.
         cl::Event event;
@@ -149,6 +90,10 @@ void pzcAtomicAdd(size_t num, const std::vector<double>& src, double& dst)
         command_queue.flush();
         command_queue.finish();
 
+        cl_ulong start, end;
+        event.getProfilingInfo(CL_PROFILING_COMMAND_START, &start);
+        event.getProfilingInfo(CL_PROFILING_COMMAND_END, &end);
+        return (end - start) / 1e6;
     } catch (const cl::Error& e) {
         std::stringstream msg;
         msg << "CL Error : " << e.what() << " " << e.err();
@@ -168,6 +113,86 @@ bool verify(const double actual, const double expected)
 
     return is_true;
 }
+
+// Contended and hierarchical atomic adds over growing prefixes of src.
+bool benchmarkAtomicAdd(const std::vector<double>& src)
+{
+    bool ok = true;
+    std::printf("%12s %14s %14s %14s %14s\n", "num", "contended ms", "Madd/s", "hierarchy ms", "Madd/s");
+    for (size_t n = std::min<size_t>(1024, src.size());; n = std::min(n * 8, src.size())) {
+        double expected = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            expected += src[i];
+        }
+
+        double contended = 0.0, hierarchical = 0.0;
+        double contended_ms    = pzcAtomicAdd("atomic_add", n, src, contended);
+        double hierarchical_ms = pzcAtomicAdd("atomic_add_hierarchical", n, src, hierarchical);
+        std::printf("%12zu %14.4f %14.2f %14.4f %14.2f\n", n, contended_ms, n / contended_ms / 1e3, hierarchical_ms, n / hierarchical_ms / 1e3);
+
+        for (double actual : { contended, hierarchical }) {
+            if (std::fabs(actual - expected) > 1e-12 * std::fabs(expected)) {
+                std::cerr << "# ERROR " << n << " " << actual << " " << expected << std::endl;
+                ok = false;
+            }
+        }
+        if (n >= src.size()) {
+            break;
+        }
+    }
+    return ok;
+}
+
+// Histogram of the second digit of keys and radix sort of keys on the
+// device, against the host.
+bool pzcSortKeys(const std::vector<uint32_t>& keys)
+{
+    const size_t num = keys.size();
+    try {
+        auto device = pzcl::DevicePool::instance().checkout(0, "kernel/kernel.pz");
+
+        // Send keys.
+        auto  pooled_keys = device->buffers->acquire(sizeof(uint32_t) * std::max<size_t>(num, 1));
+        auto& device_keys = pooled_keys.get();
+        if (num > 0) {
+            device->queue.enqueueWriteBuffer(device_keys, true, 0, sizeof(uint32_t) * num, &keys[0]);
+        }
+
+        // histogram
+        std::vector<uint32_t> expected_bins(RADIX, 0);
+        for (auto k : keys) {
+            expected_bins[(k >> RADIX_BITS) & (RADIX - 1)]++;
+        }
+        const bool histogram_ok = histogram(*device, device_keys, num, RADIX_BITS) == expected_bins;
+        std::cout << "histogram   " << (histogram_ok ? "PASS" : "FAIL") << std::endl;
+
+        // radix sort
+        auto start = std::chrono::steady_clock::now();
+        radixSort(*device, device_keys, num);
+        auto end = std::chrono::steady_clock::now();
+
+        std::vector<uint32_t> actual(num);
+        if (num > 0) {
+            device->queue.enqueueReadBuffer(device_keys, true, 0, sizeof(uint32_t) * num, &actual[0]);
+        }
+
+        std::vector<uint32_t> expected(keys);
+        auto                  host_start = std::chrono::steady_clock::now();
+        std::sort(expected.begin(), expected.end());
+        auto host_end = std::chrono::steady_clock::now();
+
+        const bool sort_ok = actual == expected;
+        std::cout << "radix sort  " << (sort_ok ? "PASS" : "FAIL")
+                  << "  device " << std::chrono::duration<double, std::milli>(end - start).count() << " ms"
+                  << "  std::sort " << std::chrono::duration<double, std::milli>(host_end - host_start).count() << " ms" << std::endl;
+
+        return histogram_ok && sort_ok;
+    } catch (const cl::Error& e) {
+        std::stringstream msg;
+        msg << "CL Error : " << e.what() << " " << e.err();
+        throw std::runtime_error(msg.str());
+    }
+}
 }
 
 int main(int argc, char** argv)
@@ -190,10 +215,22 @@ int main(int argc, char** argv)
     cpuAtomicAdd(num, src, dst_cpu);
 
     // run device atomic add
-    pzcAtomicAdd(num, src, dst_sc);
+    pzcl::DevicePool::instance().checkout()->showDeviceInfo();
+    pzcAtomicAdd("atomic_add", num, src, dst_sc);
+
+    // contended vs hierarchical
+    const bool benchmark_ok = benchmarkAtomicAdd(src);
+
+    // histogram and radix sort of random keys
+    std::vector<uint32_t>                   keys(num);
+    std::uniform_int_distribution<uint32_t> rnd;
+    for (auto& k : keys) {
+        k = rnd(mt);
+    }
+    const bool sort_ok = pzcSortKeys(keys);
 
     // verify
-    if (verify(dst_sc, dst_cpu)) {
+    if (verify(dst_sc, dst_cpu) && benchmark_ok && sort_ok) {
         std::cout << "PASS" << std::endl;
         return 0;
     } else {
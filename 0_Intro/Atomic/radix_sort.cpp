@@ -0,0 +1,63 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "radix_sort.hpp"
+
+namespace {
+// Stack of each thread. The local bins of both kernels take 8KB, more
+// than the default stacks leave (2.5KB * 8 of 20KB on SC2).
+constexpr size_t STACK_SIZE = 1024;
+}
+
+std::vector<uint32_t> histogram(pzcl::PooledDevice& device, const cl::Buffer& keys, size_t num, uint32_t shift)
+{
+    // The kernel adds to the bins, so they start cleared.
+    std::vector<uint32_t> bins(RADIX, 0);
+    auto                  pooled_bins = device.buffers->acquire(sizeof(uint32_t) * RADIX);
+    device.queue.enqueueWriteBuffer(pooled_bins.get(), false, 0, sizeof(uint32_t) * RADIX, &bins[0]);
+
+    // Get Kernel.
+    auto& kernel = device.kernel("histogram");
+    pzcl::setPerThreadStackSize(kernel, STACK_SIZE);
+
+    // Set kernel args.
+    kernel.setArg(0, pooled_bins.get());
+    kernel.setArg(1, num);
+    kernel.setArg(2, keys);
+    kernel.setArg(3, shift);
+
+    // Run kernel and get bins.
+    device.queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(device.global_work_size), cl::NullRange, nullptr, nullptr);
+    device.queue.enqueueReadBuffer(pooled_bins.get(), true, 0, sizeof(uint32_t) * RADIX, &bins[0]);
+    return bins;
+}
+
+void radixSort(pzcl::PooledDevice& device, cl::Buffer& keys, size_t num)
+{
+    if (num == 0) {
+        return;
+    }
+
+    // Keys go back and forth between keys and work. After an even number
+    // of passes they are back in keys.
+    auto pooled_work   = device.buffers->acquire(sizeof(uint32_t) * num);
+    auto pooled_counts = device.buffers->acquire(sizeof(size_t) * RADIX * (device.global_work_size / 8));
+
+    // Get Kernel.
+    auto& kernel = device.kernel("radix_sort_pass");
+    pzcl::setPerThreadStackSize(kernel, STACK_SIZE);
+    kernel.setArg(2, num);
+    kernel.setArg(4, pooled_counts.get());
+
+    for (uint32_t shift = 0; shift < 32; shift += RADIX_BITS) {
+        const bool even = (shift / RADIX_BITS) % 2 == 0;
+        kernel.setArg(0, even ? pooled_work.get() : keys);
+        kernel.setArg(1, even ? keys : pooled_work.get());
+        kernel.setArg(3, shift);
+        device.queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(device.global_work_size), cl::NullRange, nullptr, nullptr);
+    }
+    device.queue.finish();
+}
@@ -0,0 +1,29 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Histogram and radix sort of keys on the device
+ * @details   Both work on uint32_t keys already in a device buffer, with
+ *            the pzc_histogram and pzc_radix_sort_pass kernels. Keys are
+ *            binned by 8-bit digits, so a sort is four passes.
+ */
+
+#ifndef RADIX_SORT_HPP
+#define RADIX_SORT_HPP
+
+#include "pzcl_device_pool.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+constexpr size_t   RADIX      = 256;
+constexpr uint32_t RADIX_BITS = 8;
+
+// Number of each digit (key >> shift) & 255 among num keys.
+std::vector<uint32_t> histogram(pzcl::PooledDevice& device, const cl::Buffer& keys, size_t num, uint32_t shift);
+
+// Sorts num keys in ascending order. The sort is stable, and the keys
+// stay on the device.
+void radixSort(pzcl::PooledDevice& device, cl::Buffer& keys, size_t num);
+
+#endif
@@ -0,0 +1,60 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "executor.hpp"
+#include <exception>
+#include <thread>
+
+namespace {
+void parallelFor(size_t count, const std::function<void(size_t)>& task)
+{
+    std::vector<std::exception_ptr> errors(count);
+    std::vector<std::thread>        threads;
+    threads.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        threads.emplace_back([&task, &errors, i] {
+            try {
+                task(i);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    for (const auto& e : errors) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+}
+}
+
+MultiDeviceExecutor::MultiDeviceExecutor(const std::vector<cl::Device>& devices_, const std::string& kernel_file)
+    : devices(devices_.size())
+{
+    // Map the kernel binary once for all devices
+    const pzcl::MappedFile binary(kernel_file);
+
+    parallelFor(devices.size(), [&](size_t i) {
+        auto& d = devices[i];
+
+        // Init Context, Queue and Program
+        d.device           = devices_[i];
+        d.context          = cl::Context(d.device);
+        d.queue            = cl::CommandQueue(d.context, d.device);
+        d.program          = pzcl::createProgram(d.context, { d.device }, binary.data(), binary.size());
+        d.global_work_size = pzcl::getGlobalWorkSize(d.device);
+    });
+}
+
+void MultiDeviceExecutor::run(const std::function<void(size_t, Device&)>& task)
+{
+    parallelFor(devices.size(), [&](size_t i) { task(i, devices[i]); });
+}
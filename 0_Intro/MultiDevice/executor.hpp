@@ -0,0 +1,45 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Runs work on several devices at once
+ * @details   Every device gets its own context, queue and program, and its
+ *            own host thread, so device setup and launches overlap instead
+ *            of running one device after another.
+ */
+
+#ifndef EXECUTOR_HPP
+#define EXECUTOR_HPP
+
+#include "pzcl_runtime.hpp"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+class MultiDeviceExecutor {
+public:
+    struct Device {
+        cl::Device       device;
+        cl::Context      context;
+        cl::CommandQueue queue;
+        cl::Program      program;
+        size_t           global_work_size;
+    };
+
+    // Sets up all devices concurrently with the program in kernel_file.
+    MultiDeviceExecutor(const std::vector<cl::Device>& devices, const std::string& kernel_file);
+
+    size_t  size() const { return devices.size(); }
+    Device& operator[](size_t i) { return devices[i]; }
+
+    // Calls task(i, device) for every device, each on its own host thread,
+    // and returns when all of them are done. The first exception thrown by
+    // a task is rethrown here.
+    void run(const std::function<void(size_t, Device&)>& task);
+
+private:
+    std::vector<Device> devices;
+};
+
+#endif
@@ -4,87 +4,119 @@
  * @copyright BSD-3-Clause
  */
 
-#define __CL_ENABLE_EXCEPTIONS
-#include <CL/cl.hpp>
-#include <cassert>
-#include <fstream>
+#include "executor.hpp"
+#include "partition.hpp"
+#include "scheduler.hpp"
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <random>
 #include <sstream>
 #include <stdexcept>
 #include <vector>
 
-std::vector<unsigned char> read_pz_binary()
-{
-    std::string filename = "kernel/kernel.pz";
-
-    std::ifstream              ifs(filename, std::ios::binary);
-    std::vector<unsigned char> bin((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
-    if (bin.empty()) {
-        throw std::runtime_error("Cannot open PZ Binary");
-    }
-    return bin;
-}
+namespace {
+// Chunk boundaries in elements: 64 bytes of uint32_t.
+constexpr size_t ALIGN = 64 / sizeof(uint32_t);
 
-void fill_multi_device(std::vector<uint32_t>& a, uint32_t value)
-{
-    const size_t N = a.size();
-
-    // Init platform
-    std::vector<cl::Platform> platforms;
-    cl::Platform::get(&platforms);
-    if (platforms.size() == 0) {
-        throw std::runtime_error("No platform found");
-    }
-    cl::Platform plat = platforms[0];
+// Elements filled by each device to measure its speed.
+constexpr size_t CALIBRATION_SIZE = 1 << 20;
 
-    // Init device
-    std::vector<cl::Device> devs;
-    plat.getDevices(CL_DEVICE_TYPE_ALL, &devs);
-    if (devs.size() == 0) {
-        throw std::runtime_error("No devices found");
-    }
+// Elements per chunk of the work-stealing scheduler.
+constexpr size_t CHUNK_SIZE = 1 << 16;
 
-    const size_t M = devs.size();
-    std::clog << "Use " << M << " device(s)" << std::endl;
-
-    assert(N % M == 0); // Consider M|N case for simplicity
-    const size_t L = N / M;
-
-    const auto pz_binary = read_pz_binary();
+void fill(MultiDeviceExecutor::Device& d, cl::Buffer& buf, size_t num, uint32_t value)
+{
+    // Setup device kernel. See also the definition in pzc/kernel.pzc
+    auto kernel = cl::make_kernel<size_t, cl::Buffer&, uint32_t>(d.program, "fill");
+    kernel(cl::EnqueueArgs(d.queue, cl::NDRange(d.global_work_size)), num, buf, value);
+}
 
-    std::vector<cl::Context>      contexts;
-    std::vector<cl::CommandQueue> queues;
-    std::vector<cl::Buffer>       buffers;
+// Throughput of each device in elements per second, timed on a short fill
+// after one untimed warm-up launch.
+std::vector<double> calibrate(MultiDeviceExecutor& executor)
+{
+    std::vector<double> weights(executor.size());
 
-    for (size_t i = 0; i < M; ++i) {
-        auto dev = devs[i];
+    executor.run([&](size_t i, MultiDeviceExecutor::Device& d) {
+        cl::Buffer buf(d.context, CL_MEM_READ_WRITE, sizeof(uint32_t) * CALIBRATION_SIZE);
 
-        // Init Context, Buffers, and Queue
-        cl::Context      context(dev);
-        cl::CommandQueue queue(context, dev);
-        cl::Buffer       buf(context, CL_MEM_READ_WRITE, sizeof(uint32_t) * L);
+        fill(d, buf, CALIBRATION_SIZE, 0);
+        d.queue.finish();
 
-        // Setup device program. See also the definition in pzc/kernel.pzc
-        cl::Program::Binaries bins = { { &pz_binary[0], pz_binary.size() } };
+        const auto begin = std::chrono::steady_clock::now();
+        fill(d, buf, CALIBRATION_SIZE, 0);
+        d.queue.finish();
+        const auto end = std::chrono::steady_clock::now();
 
-        cl::Program program(context, { dev }, bins);
-        auto        kernel = cl::make_kernel<size_t, cl::Buffer&, uint32_t>(program, "fill");
+        const double sec = std::chrono::duration<double>(end - begin).count();
+        weights[i]       = CALIBRATION_SIZE / std::max(sec, 1e-9);
+    });
+    return weights;
+}
+}
 
-        size_t work_size = dev.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>()[0];
-        std::clog << "Work size = " << work_size << std::endl;
+// Static split: each device fills one range sized by its weight.
+void fill_multi_device(MultiDeviceExecutor& executor, const std::vector<double>& weights, std::vector<uint32_t>& a, uint32_t value)
+{
+    const size_t N      = a.size();
+    const auto   ranges = partition(N, weights, ALIGN);
+    for (size_t i = 0; i < executor.size(); ++i) {
+        std::clog << "Device " << i << ": range = [" << ranges[i].offset << ", " << ranges[i].offset + ranges[i].size << ")" << std::endl;
+    }
 
-        kernel(cl::EnqueueArgs(queue, cl::NDRange(work_size)), N, buf, value);
-        cl::copy(queue, buf, a.begin() + i * L, a.begin() + (i + 1) * L);
+    // Each device fills its part on its own host thread.
+    // The launch and the read back are queued without blocking,
+    // and run() returns when every device has finished.
+    executor.run([&](size_t i, MultiDeviceExecutor::Device& d) {
+        const Range& r = ranges[i];
+        if (r.size == 0) {
+            return;
+        }
+
+        cl::Buffer buf(d.context, CL_MEM_READ_WRITE, sizeof(uint32_t) * r.size);
+
+        fill(d, buf, r.size, value);
+        d.queue.enqueueReadBuffer(buf, CL_FALSE, 0, sizeof(uint32_t) * r.size, &a[r.offset]);
+        d.queue.finish();
+    });
+}
 
-        contexts.push_back(std::move(context));
-        queues.push_back(std::move(queue));
-        buffers.push_back(std::move(buf));
+// Dynamic split: devices take chunks from their own deque and steal from
+// the others when it runs dry.
+void fill_multi_device_dynamic(MultiDeviceExecutor& executor, const std::vector<double>& weights, std::vector<uint32_t>& a, uint32_t value)
+{
+    const size_t   N = a.size();
+    ChunkScheduler scheduler(N, CHUNK_SIZE, weights, ALIGN);
+
+    executor.run([&](size_t i, MultiDeviceExecutor::Device& d) {
+        cl::Buffer buf(d.context, CL_MEM_READ_WRITE, sizeof(uint32_t) * N);
+
+        // Setup device kernel. See also the definition in pzc/kernel.pzc
+        auto kernel = cl::make_kernel<size_t, size_t, cl::Buffer&, uint32_t>(d.program, "fill_range");
+
+        scheduler.work(i, [&](const Range& r) {
+            kernel(cl::EnqueueArgs(d.queue, cl::NDRange(d.global_work_size)), r.offset, r.size, buf, value);
+            d.queue.enqueueReadBuffer(buf, CL_FALSE, sizeof(uint32_t) * r.offset, sizeof(uint32_t) * r.size, &a[r.offset]);
+            d.queue.finish();
+        });
+    });
+
+    for (size_t i = 0; i < executor.size(); ++i) {
+        const auto s = scheduler.stats(i);
+        std::clog << "Device " << i << ": " << s.chunks << " chunks (" << s.stolen << " stolen)"
+                  << ", busy " << s.busy * 1000 << " ms, idle " << s.idle * 1000 << " ms" << std::endl;
     }
+}
 
-    for (auto&& queue : queues) {
-        queue.finish();
+bool check(const std::vector<uint32_t>& a, uint32_t value)
+{
+    for (auto v : a) {
+        if (v != value) {
+            return false;
+        }
     }
+    return true;
 }
 
 int main(int argc, char* argv[])
@@ -93,24 +125,35 @@ int main(int argc, char* argv[])
               << "Program: " << argv[0] << "\n"
               << std::endl;
 
-    constexpr int      N     = 400;
-    constexpr uint32_t value = 1234;
-
-    // array to be filled
-    std::vector<uint32_t> a(N, 0);
+    constexpr int N = 1000003; // need not be a multiple of the device count
 
+    bool ok = true;
     try {
-        fill_multi_device(a, value);
+        // Init Context, Queue and Program of every device concurrently
+        MultiDeviceExecutor executor(pzcl::getDevices(CL_DEVICE_TYPE_ALL), "kernel/kernel.pz");
+
+        std::clog << "Use " << executor.size() << " device(s)" << std::endl;
+
+        // Give each device a share of the array proportional to its speed
+        const auto weights = calibrate(executor);
+        for (size_t i = 0; i < executor.size(); ++i) {
+            std::clog << "Device " << i << ": work size = " << executor[i].global_work_size
+                      << ", " << weights[i] << " elements/s" << std::endl;
+        }
+
+        // array to be filled
+        std::vector<uint32_t> a(N, 0);
+        fill_multi_device(executor, weights, a, 1234);
+        ok = check(a, 1234) && ok;
+
+        fill_multi_device_dynamic(executor, weights, a, 5678);
+        ok = check(a, 5678) && ok;
     } catch (const cl::Error& e) {
         std::cerr << "PZCL Error : " << e.what() << " " << e.err();
         return 1;
     }
 
-    // Check the array is filled
-    for (auto v : a) {
-        assert(v == value);
-    }
-
+    std::clog << (ok ? "PASS" : "FAIL") << std::endl;
     std::clog << "-----------------------------------------------" << std::endl;
-    return 0;
+    return ok ? 0 : 1;
 }
@@ -0,0 +1,58 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "partition.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+std::vector<Range> partition(size_t n, const std::vector<double>& weights, size_t align)
+{
+    if (weights.empty() || align == 0) {
+        throw std::invalid_argument("partition: no device or zero alignment");
+    }
+    for (auto w : weights) {
+        if (!(w >= 0.0) || std::isinf(w)) {
+            throw std::invalid_argument("partition: invalid weight");
+        }
+    }
+    const double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+    if (total <= 0.0) {
+        throw std::invalid_argument("partition: all weights are zero");
+    }
+
+    // Round the ideal cumulative boundaries, not the sizes, so that the
+    // rounding errors do not add up and the ranges always cover [0, n).
+    // The prefix sum reaches total exactly at the last non-zero weight,
+    // which therefore ends at n.
+    std::vector<Range> ranges(weights.size());
+    size_t             begin = 0;
+    double             sum   = 0.0;
+    for (size_t i = 0; i < weights.size(); ++i) {
+        sum += weights[i];
+
+        size_t end = n;
+        if (i + 1 < weights.size() && sum < total) {
+            const double ideal = static_cast<double>(n) * (sum / total);
+            end                = static_cast<size_t>(std::llround(ideal / align)) * align;
+            end                = std::min(std::max(end, begin), n);
+        }
+        if (weights[i] == 0.0) {
+            end = begin;
+        }
+
+        ranges[i] = { begin, end - begin };
+        begin     = end;
+    }
+
+    return ranges;
+}
+
+std::vector<Range> partition(size_t n, size_t count, size_t align)
+{
+    return partition(n, std::vector<double>(count, 1.0), align);
+}
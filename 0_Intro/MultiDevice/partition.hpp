@@ -0,0 +1,31 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Splits an index range between devices
+ * @details   Every device gets a share proportional to its weight, e.g. its
+ *            measured throughput, so that a slower device does not hold up
+ *            the others. Chunk boundaries are multiples of an alignment so
+ *            that each device transfers whole cache lines / DMA blocks.
+ */
+
+#ifndef PARTITION_HPP
+#define PARTITION_HPP
+
+#include <cstddef>
+#include <vector>
+
+struct Range {
+    size_t offset;
+    size_t size;
+};
+
+// Splits [0, n) into weights.size() contiguous ranges in order. All
+// boundaries except n itself are multiples of align. A device with zero
+// weight gets an empty range. Weights must not all be zero.
+std::vector<Range> partition(size_t n, const std::vector<double>& weights, size_t align = 1);
+
+// Same as above with equal weights.
+std::vector<Range> partition(size_t n, size_t count, size_t align = 1);
+
+#endif
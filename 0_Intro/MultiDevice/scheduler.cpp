@@ -0,0 +1,126 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "scheduler.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+ChunkScheduler::ChunkScheduler(size_t n_, size_t chunk_size_, const std::vector<double>& weights, size_t align)
+    : n(n_)
+    , chunk_size(0)
+{
+    if (align == 0) {
+        throw std::invalid_argument("ChunkScheduler: zero alignment");
+    }
+    chunk_size = (std::max<size_t>(chunk_size_, 1) + align - 1) / align * align;
+
+    // Seed every deque with a contiguous run of chunks, sized by weight.
+    const size_t num_chunks = (n + chunk_size - 1) / chunk_size;
+    const auto   ranges     = partition(num_chunks, weights);
+    for (const auto& r : ranges) {
+        std::unique_ptr<Queue> q(new Queue);
+        for (size_t c = r.offset; c < r.offset + r.size; ++c) {
+            q->chunks.push_back(c);
+        }
+        q->stats = Stats{ 0, 0, 0.0, 0.0 };
+        queues.push_back(std::move(q));
+    }
+}
+
+ChunkScheduler::ChunkScheduler(size_t n_, size_t chunk_size_, size_t workers, size_t align)
+    : ChunkScheduler(n_, chunk_size_, std::vector<double>(workers, 1.0), align)
+{
+}
+
+bool ChunkScheduler::pop(size_t worker, size_t& chunk)
+{
+    Queue&                      q = *queues[worker];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.chunks.empty()) {
+        return false;
+    }
+    chunk = q.chunks.front();
+    q.chunks.pop_front();
+    return true;
+}
+
+bool ChunkScheduler::steal(size_t worker, size_t& chunk)
+{
+    for (;;) {
+        // Pick the fullest victim. The sizes may change before it is locked,
+        // so an empty victim only means to look again.
+        size_t victim = worker;
+        size_t most   = 0;
+        for (size_t i = 0; i < queues.size(); ++i) {
+            if (i == worker) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(queues[i]->mutex);
+            if (queues[i]->chunks.size() > most) {
+                most   = queues[i]->chunks.size();
+                victim = i;
+            }
+        }
+        if (most == 0) {
+            return false;
+        }
+
+        Queue&                      q = *queues[victim];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.chunks.empty()) {
+            chunk = q.chunks.back();
+            q.chunks.pop_back();
+            return true;
+        }
+    }
+}
+
+void ChunkScheduler::work(size_t worker, const std::function<void(const Range&)>& process)
+{
+    Queue& q = *queues[worker];
+    q.begin  = Clock::now();
+
+    size_t chunk;
+    for (;;) {
+        bool stolen = false;
+        if (!pop(worker, chunk)) {
+            if (!steal(worker, chunk)) {
+                break;
+            }
+            stolen = true;
+        }
+
+        const size_t offset = chunk * chunk_size;
+        const Range  r      = { offset, std::min(chunk_size, n - offset) };
+
+        const auto begin = Clock::now();
+        process(r);
+        const auto end = Clock::now();
+
+        q.stats.busy += std::chrono::duration<double>(end - begin).count();
+        q.stats.chunks++;
+        if (stolen) {
+            q.stats.stolen++;
+        }
+    }
+
+    q.end = Clock::now();
+}
+
+ChunkScheduler::Stats ChunkScheduler::stats(size_t worker) const
+{
+    // The run lasts from the first worker starting to the last one ending.
+    Clock::time_point begin = queues[0]->begin;
+    Clock::time_point end   = queues[0]->end;
+    for (const auto& q : queues) {
+        begin = std::min(begin, q->begin);
+        end   = std::max(end, q->end);
+    }
+
+    Stats s = queues[worker]->stats;
+    s.idle  = std::max(0.0, std::chrono::duration<double>(end - begin).count() - s.busy);
+    return s;
+}
@@ -0,0 +1,66 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Work-stealing chunk scheduler for several devices
+ * @details   A 1-D range is cut into fixed-size chunks. Each worker (the
+ *            host thread driving one device) owns a deque of chunks, seeded
+ *            in proportion to its weight, and takes chunks from its front.
+ *            A worker whose deque is empty steals from the back of the
+ *            fullest other deque, so a device slowed down by interference
+ *            simply processes fewer chunks.
+ */
+
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include "partition.hpp"
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class ChunkScheduler {
+public:
+    struct Stats {
+        size_t chunks; // chunks processed
+        size_t stolen; // of which taken from other workers
+        double busy;   // seconds spent processing chunks
+        double idle;   // seconds of the whole run not spent processing
+    };
+
+    // chunk_size is rounded up to a multiple of align.
+    ChunkScheduler(size_t n, size_t chunk_size, const std::vector<double>& weights, size_t align = 1);
+    ChunkScheduler(size_t n, size_t chunk_size, size_t workers, size_t align = 1);
+
+    // Calls process(chunk) until no chunk is left anywhere. Every worker
+    // calls this exactly once, on its own thread.
+    void work(size_t worker, const std::function<void(const Range&)>& process);
+
+    // Valid after all work() calls have returned.
+    Stats  stats(size_t worker) const;
+    size_t workers() const { return queues.size(); }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Queue {
+        std::mutex         mutex;
+        std::deque<size_t> chunks;
+        Stats              stats;
+        Clock::time_point  begin;
+        Clock::time_point  end;
+    };
+
+    bool pop(size_t worker, size_t& chunk);
+    bool steal(size_t worker, size_t& chunk);
+
+    size_t                              n;
+    size_t                              chunk_size;
+    std::vector<std::unique_ptr<Queue>> queues;
+};
+
+#endif
@@ -4,10 +4,11 @@
  * @copyright BSD-3-Clause
  */
 
-#define __CL_ENABLE_EXCEPTIONS
-#include <CL/cl.hpp>
+#include "pzcl_device_pool.hpp"
+#include "pzcl_pipeline.hpp"
+#include <algorithm>
 #include <cassert>
-#include <fstream>
+#include <chrono>
 #include <iostream>
 #include <random>
 #include <sstream>
@@ -15,8 +16,11 @@
 #include <vector>
 
 namespace {
+// Host arrays in pinned memory of the device, see main.
+typedef pzcl::PinnedVector<double> HostVector;
+
 std::mt19937 mt(0);
-inline void  initVector(std::vector<double>& src)
+inline void  initVector(HostVector& src)
 {
     std::uniform_real_distribution<> rnd01(0.0, 1.0);
     for (auto& s : src) {
@@ -24,86 +28,33 @@ inline void  initVector(std::vector<double>& src)
     }
 }
 
-void cpuAdd(size_t num, std::vector<double>& dst, const std::vector<double>& src0, const std::vector<double>& src1)
+void cpuAdd(size_t num, HostVector& dst, const HostVector& src0, const HostVector& src1)
 {
     for (size_t i = 0; i < num; ++i) {
         dst[i] = src0[i] + src1[i];
     }
 }
 
-inline size_t getFileSize(std::ifstream& file)
-{
-    file.seekg(0, std::ios::end);
-    size_t ret = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    return ret;
-}
-
-inline void loadFile(std::ifstream& file, std::vector<char>& d, size_t size)
-{
-    d.resize(size);
-    file.read(reinterpret_cast<char*>(d.data()), size);
-}
-
-cl::Program createProgram(cl::Context& context, const std::vector<cl::Device>& devices, const std::string& filename)
-{
-    std::ifstream file;
-    file.open(filename, std::ios::in | std::ios::binary);
-
-    if (file.fail()) {
-        throw "can not open kernel file";
-    }
-
-    size_t            filesize = getFileSize(file);
-    std::vector<char> binary_data;
-    loadFile(file, binary_data, filesize);
-
-    cl::Program::Binaries binaries;
-    binaries.push_back(std::make_pair(&binary_data[0], filesize));
-
-    return cl::Program(context, devices, binaries, nullptr, nullptr);
-}
-
-cl::Program createProgram(cl::Context& context, const cl::Device& device, const std::string& filename)
-{
-    std::vector<cl::Device> devices { device };
-    return createProgram(context, devices, filename);
-}
-
-void pzcAdd(size_t num, std::vector<double>& dst, const std::vector<double>& src0, const std::vector<double>& src1)
+void pzcAdd(size_t num, HostVector& dst, const HostVector& src0, const HostVector& src1)
 {
     try {
-        // Get Platform
-        std::vector<cl::Platform> platforms;
-        cl::Platform::get(&platforms);
-        const auto& Platform = platforms[0];
-
-        // Get devices
-        std::vector<cl::Device> devices;
-        Platform.getDevices(CL_DEVICE_TYPE_DEFAULT, &devices);
-
-        // Use first device.
-        const auto& device = devices[0];
-
-        // Create Context.
-        auto context = cl::Context(device);
-
-        // Create CommandQueue.
-        auto command_queue = cl::CommandQueue(context, device, 0);
-
-        // Create Program.
-        // Load compiled binary file and create cl::Program object.
-        auto program = createProgram(context, device, "kernel/kernel.pz");
+        // Check out Context, CommandQueue and Program of first device.
+        // Only the first call creates them, later calls reuse them.
+        auto  device        = pzcl::DevicePool::instance().checkout(0, "kernel/kernel.pz");
+        auto& command_queue = device->queue;
 
-        // Create Kernel.
+        // Get Kernel.
         // Give kernel name without pzc_ prefix.
-        auto kernel = cl::Kernel(program, "add");
+        auto& kernel = device->kernel("add");
 
-        // Create Buffers.
-        auto device_src0 = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(double) * num);
-        auto device_src1 = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(double) * num);
-        auto device_dst  = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(double) * num);
+        // Get Buffers.
+        // They go back to the pool of the device at the end of the call.
+        auto  pooled_src0 = device->buffers->acquire(sizeof(double) * num);
+        auto  pooled_src1 = device->buffers->acquire(sizeof(double) * num);
+        auto  pooled_dst  = device->buffers->acquire(sizeof(double) * num);
+        auto& device_src0 = pooled_src0.get();
+        auto& device_src1 = pooled_src1.get();
+        auto& device_dst  = pooled_dst.get();
 
         // Send src.
         command_queue.enqueueWriteBuffer(device_src0, true, 0, sizeof(double) * num, &src0[0]);
@@ -121,24 +72,7 @@ void pzcAdd(size_t num, std::vector<double>& dst, const std::vector<double>& src
         kernel.setArg(3, device_src1);
 
         // Get workitem size.
-        // sc1-64: 8192  (1024 PEs * 8 threads)
-        // sc2   : 15782 (1984 PEs * 8 threads)
-        size_t global_work_size = 0;
-        {
-            std::string device_name;
-            device.getInfo(CL_DEVICE_NAME, &device_name);
-
-            size_t global_work_size_[3] = { 0 };
-            device.getInfo(CL_DEVICE_MAX_WORK_ITEM_SIZES, &global_work_size_);
-
-            global_work_size = global_work_size_[0];
-            if (device_name.find("PEZY-SC2") != std::string::npos) {
-                global_work_size = std::min(global_work_size, (size_t)15872);
-            }
-
-            std::cout << "Use device : " << device_name << std::endl;
-            std::cout << "workitem   : " << global_work_size << std::endl;
-        }
+        const size_t global_work_size = device->global_work_size;
 
         // Run device kernel.
         cl::Event event;
@@ -161,7 +95,62 @@ void pzcAdd(size_t num, std::vector<double>& dst, const std::vector<double>& src
     }
 }
 
-bool verify(const std::vector<double>& actual, const std::vector<double>& expected)
+// Same as pzcAdd, but in chunks of chunk_size elements so that transfers
+// of one chunk overlap the kernel of another. depth chunks are in flight.
+void pzcAddPipelined(size_t num, HostVector& dst, const HostVector& src0, const HostVector& src1, size_t chunk_size, size_t depth)
+{
+    try {
+        auto  device = pzcl::DevicePool::instance().checkout(0, "kernel/kernel.pz");
+        auto& kernel = device->kernel("add");
+
+        pzcl::Pipeline pipeline(device->context, device->device, depth);
+        chunk_size = std::max<size_t>(std::min(chunk_size, num), 1);
+
+        // Get src0, src1 and dst buffers of a chunk for each slot.
+        std::vector<pzcl::BufferPool::Buffer> buffers;
+        for (size_t i = 0; i < 3 * depth; ++i) {
+            buffers.push_back(device->buffers->acquire(sizeof(double) * chunk_size));
+        }
+        auto buffer = [&](size_t slot, size_t i) -> cl::Buffer& { return buffers[3 * slot + i].get(); };
+
+        // Send src of the chunk.
+        auto upload = [&](const pzcl::Pipeline::Chunk& c, cl::CommandQueue& queue, const std::vector<cl::Event>& wait) {
+            cl::Event event;
+            queue.enqueueWriteBuffer(buffer(c.slot, 0), false, 0, sizeof(double) * c.size, &src0[c.offset], &wait);
+            queue.enqueueWriteBuffer(buffer(c.slot, 1), false, 0, sizeof(double) * c.size, &src1[c.offset], nullptr, &event);
+            return event;
+        };
+
+        // Run device kernel on the chunk.
+        // Arguments are captured at enqueue, so the kernel is reused.
+        auto compute = [&](const pzcl::Pipeline::Chunk& c, cl::CommandQueue& queue, const std::vector<cl::Event>& wait) {
+            kernel.setArg(0, c.size);
+            kernel.setArg(1, buffer(c.slot, 2));
+            kernel.setArg(2, buffer(c.slot, 0));
+            kernel.setArg(3, buffer(c.slot, 1));
+
+            cl::Event event;
+            queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(device->global_work_size), cl::NullRange, &wait, &event);
+            return event;
+        };
+
+        // Get dst of the chunk.
+        auto download = [&](const pzcl::Pipeline::Chunk& c, cl::CommandQueue& queue, const std::vector<cl::Event>& wait) {
+            cl::Event event;
+            queue.enqueueReadBuffer(buffer(c.slot, 2), false, 0, sizeof(double) * c.size, &dst[c.offset], &wait, &event);
+            return event;
+        };
+
+        pipeline.run(num, chunk_size, upload, compute, download);
+
+    } catch (const cl::Error& e) {
+        std::stringstream msg;
+        msg << "CL Error : " << e.what() << " " << e.err();
+        throw std::runtime_error(msg.str());
+    }
+}
+
+bool verify(const HostVector& actual, const HostVector& expected)
 {
     assert(actual.size() == expected.size());
 
@@ -186,30 +175,67 @@ bool verify(const std::vector<double>& actual, const std::vector<double>& expect
 
 int main(int argc, char** argv)
 {
-    size_t num = 1024;
+    size_t num        = 1024;
+    size_t chunk_size = 1 << 20;
+    size_t depth      = 3;
 
     if (argc > 1) {
         num = strtol(argv[1], nullptr, 10);
     }
+    if (argc > 2) {
+        chunk_size = strtol(argv[2], nullptr, 10);
+    }
+    if (argc > 3) {
+        depth = strtol(argv[3], nullptr, 10);
+    }
 
     std::cout << "num " << num << std::endl;
 
-    std::vector<double> src0(num);
-    std::vector<double> src1(num);
+    // Allocate the arrays transferred to the device from pinned memory.
+    // The pool locks its blocks once, not on every transfer.
+    auto                          pinned = pzcl::DevicePool::instance().checkout()->pinned;
+    pzcl::PinnedAllocator<double> alloc(pinned.get());
+
+    HostVector src0(num, 0, alloc);
+    HostVector src1(num, 0, alloc);
     initVector(src0);
     initVector(src1);
 
-    std::vector<double> dst_sc(num, 0);
-    std::vector<double> dst_cpu(num, 0);
+    HostVector dst_sc(num, 0, alloc);
+    HostVector dst_cpu(num, 0);
 
     // run cpu add
     cpuAdd(num, dst_cpu, src0, src1);
 
     // run device add
-    pzcAdd(num, dst_sc, src0, src1);
+    // The first call sets up the device, later calls reuse it from the pool.
+    pzcl::DevicePool::instance().checkout()->showDeviceInfo();
+    for (int i = 0; i < 5; ++i) {
+        const auto begin = std::chrono::steady_clock::now();
+        pzcAdd(num, dst_sc, src0, src1);
+        const auto end = std::chrono::steady_clock::now();
+        std::cout << "call " << i << "     : " << std::chrono::duration<double, std::milli>(end - begin).count() << " ms" << std::endl;
+    }
+    {
+        auto device = pzcl::DevicePool::instance().checkout();
+        std::cout << "buffer pool: " << device->buffers->hits() << " hits, " << device->buffers->misses() << " misses" << std::endl;
+    }
+
+    bool ok = verify(dst_sc, dst_cpu);
+
+    // run device add in overlapped chunks
+    std::fill(dst_sc.begin(), dst_sc.end(), 0);
+    {
+        const auto begin = std::chrono::steady_clock::now();
+        pzcAddPipelined(num, dst_sc, src0, src1, chunk_size, depth);
+        const auto end = std::chrono::steady_clock::now();
+        std::cout << "pipelined  : " << std::chrono::duration<double, std::milli>(end - begin).count() << " ms"
+                  << " (chunk " << chunk_size << ", depth " << depth << ")" << std::endl;
+    }
+    ok = verify(dst_sc, dst_cpu) && ok;
 
     // verify
-    if (verify(dst_sc, dst_cpu)) {
+    if (ok) {
         std::cout << "PASS" << std::endl;
     } else {
         std::cout << "FAIL" << std::endl;
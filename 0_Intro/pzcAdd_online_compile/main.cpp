@@ -4,10 +4,10 @@
  * @copyright BSD-3-Clause
  */
 
-#define __CL_ENABLE_EXCEPTIONS
-#include <CL/cl.hpp>
+#include "pzcl_program_cache.hpp"
+#include "pzcl_runtime.hpp"
+#include "pzcl_specialization.hpp"
 #include <cassert>
-#include <fstream>
 #include <iostream>
 #include <random>
 #include <sstream>
@@ -39,6 +39,46 @@ void pzc_add(size_t        num,
     flush();
 }
 )";
+
+// pzc kernel source code for pzc_add_fixed
+// ELEM_T, NUM, UNROLL and WORK_SIZE are given as -D options,
+// so the trip count and the stride are known to the compiler.
+std::string kernel_src_pzc_add_fixed = R"(
+#include <pzc_builtin.h>
+
+void pzc_add_fixed(ELEM_T*       dst,
+                   const ELEM_T* src0,
+                   const ELEM_T* src1)
+{
+    size_t pid = get_pid();
+    size_t tid = get_tid();
+    size_t gid = pid * get_maxtid() + tid;
+
+    size_t i = gid;
+    for (; i + (UNROLL - 1) * WORK_SIZE < NUM; i += UNROLL * WORK_SIZE) {
+        ELEM_T s0[UNROLL];
+        ELEM_T s1[UNROLL];
+        for (int u = 0; u < UNROLL; ++u) {
+            s0[u] = src0[i + u * WORK_SIZE];
+            s1[u] = src1[i + u * WORK_SIZE];
+        }
+        chgthread();
+        for (int u = 0; u < UNROLL; ++u) {
+            dst[i + u * WORK_SIZE] = s0[u] + s1[u];
+        }
+    }
+    for (; i < NUM; i += WORK_SIZE) {
+        ELEM_T s0 = src0[i];
+        ELEM_T s1 = src1[i];
+        chgthread();
+        dst[i] = s0 + s1;
+    }
+
+    flush();
+}
+)";
+constexpr int ADD_UNROLL = 4;
+
 std::mt19937 mt(0);
 inline void  initVector(std::vector<double>& src)
 {
@@ -55,35 +95,38 @@ void cpuAdd(size_t num, std::vector<double>& dst, const std::vector<double>& src
     }
 }
 
-void pzcAdd(size_t num, std::vector<double>& dst, const std::vector<double>& src0, const std::vector<double>& src1)
+// Runs pzc_add, or pzc_add_fixed specialized for num if specialize is set.
+void pzcAdd(size_t num, std::vector<double>& dst, const std::vector<double>& src0, const std::vector<double>& src1, bool specialize)
 {
     try {
-        // Get Platform
-        std::vector<cl::Platform> platforms;
-        cl::Platform::get(&platforms);
-        const auto& Platform = platforms[0];
-
-        // Get devices
-        std::vector<cl::Device> devices;
-        Platform.getDevices(CL_DEVICE_TYPE_DEFAULT, &devices);
-
-        // Use first device.
-        const auto& device = devices[0];
+        // Create Context and CommandQueue on first device.
+        pzcl::Runtime runtime(0);
+        auto&         context       = runtime.context;
+        auto&         command_queue = runtime.queue;
 
-        // Create Context.
-        auto context = cl::Context(device);
-
-        // Create CommandQueue.
-        auto command_queue = cl::CommandQueue(context, device, 0);
+        // Get workitem size.
+        const size_t global_work_size = runtime.global_work_size;
+        runtime.showDeviceInfo();
 
-        // Create Program.
+        // Create Program and Kernel.
         // Online compile on target device with pzc source code.
-        auto program = cl::Program(context, kernel_src_pzc_add, nullptr);
-        program.build(devices, nullptr, nullptr, nullptr);
-
-        // Create Kernel.
+        // The built binary is kept on disk, later runs load it instead of compiling.
         // Give kernel name without pzc_ prefix.
-        auto kernel = cl::Kernel(program, "add");
+        pzcl::ProgramCache cache;
+        cl::Kernel         kernel;
+        if (specialize) {
+            pzcl::KernelParams params;
+            params.defineType<double>("ELEM_T")
+                .define("NUM", num)
+                .define("UNROLL", ADD_UNROLL)
+                .define("WORK_SIZE", global_work_size);
+
+            pzcl::SpecializedProgram add_fixed(context, runtime.device, kernel_src_pzc_add_fixed, cache);
+            kernel = cl::Kernel(add_fixed.get(params), "add_fixed");
+        } else {
+            kernel = cl::Kernel(cache.build(context, runtime.device, kernel_src_pzc_add), "add");
+        }
+        std::cout << "program cache : " << (cache.hits() != 0 ? "hit" : "miss") << std::endl;
 
         // Create Buffers.
         auto device_src0 = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(double) * num);
@@ -100,30 +143,14 @@ void pzcAdd(size_t num, std::vector<double>& dst, const std::vector<double>& src
         write_event.wait();
 
         // Set kernel args.
-        kernel.setArg(0, num);
-        kernel.setArg(1, device_dst);
-        kernel.setArg(2, device_src0);
-        kernel.setArg(3, device_src1);
-
-        // Get workitem size.
-        // sc1-64: 8192  (1024 PEs * 8 threads)
-        // sc2   : 15782 (1984 PEs * 8 threads)
-        size_t global_work_size = 0;
-        {
-            std::string device_name;
-            device.getInfo(CL_DEVICE_NAME, &device_name);
-
-            size_t global_work_size_[3] = { 0 };
-            device.getInfo(CL_DEVICE_MAX_WORK_ITEM_SIZES, &global_work_size_);
-
-            global_work_size = global_work_size_[0];
-            if (device_name.find("PEZY-SC2") != std::string::npos) {
-                global_work_size = std::min(global_work_size, (size_t)15872);
-            }
-
-            std::cout << "Use device : " << device_name << std::endl;
-            std::cout << "workitem   : " << global_work_size << std::endl;
+        // num is built into pzc_add_fixed.
+        cl_uint arg = 0;
+        if (!specialize) {
+            kernel.setArg(arg++, num);
         }
+        kernel.setArg(arg++, device_dst);
+        kernel.setArg(arg++, device_src0);
+        kernel.setArg(arg++, device_src1);
 
         // Run device kernel.
         cl::Event event;
@@ -185,16 +212,20 @@ int main(int argc, char** argv)
     initVector(src1);
 
     std::vector<double> dst_sc(num, 0);
+    std::vector<double> dst_sc_fixed(num, 0);
     std::vector<double> dst_cpu(num, 0);
 
     // run cpu add
     cpuAdd(num, dst_cpu, src0, src1);
 
     // run device add
-    pzcAdd(num, dst_sc, src0, src1);
+    pzcAdd(num, dst_sc, src0, src1, false);
+
+    // run device add specialized for num
+    pzcAdd(num, dst_sc_fixed, src0, src1, true);
 
     // verify
-    if (verify(dst_sc, dst_cpu)) {
+    if (verify(dst_sc, dst_cpu) && verify(dst_sc_fixed, dst_cpu)) {
         std::cout << "PASS" << std::endl;
     } else {
         std::cout << "FAIL" << std::endl;
@@ -4,16 +4,18 @@
  * @copyright BSD-3-Clause
  */
 
-#define __CL_ENABLE_EXCEPTIONS
-#include <CL/cl.hpp>
+#include "pzcl_device_pool.hpp"
+#include "reducer.hpp"
+#include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <cmath>
 #include <cstdio>
-#include <fstream>
 #include <iostream>
 #include <random>
 #include <sstream>
 #include <stdexcept>
+#include <type_traits>
 #include <vector>
 
 namespace {
@@ -35,116 +37,149 @@ double cpuSum(const std::vector<double>& src)
     return acc;
 }
 
-inline size_t getFileSize(std::ifstream& file)
+// Neumaier-compensated sum, as pzc_sum_kahan. The error does not grow with
+// the number of elements.
+double cpuSumKahan(const std::vector<double>& src)
 {
-    file.seekg(0, std::ios::end);
-    size_t ret = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    return ret;
-}
-
-inline void loadFile(std::ifstream& file, std::vector<char>& d, size_t size)
-{
-    d.resize(size);
-    file.read(reinterpret_cast<char*>(d.data()), size);
+    double acc = 0.0;
+    double c   = 0.0;
+    for (size_t i = 0; i < src.size(); ++i) {
+        double t = acc + src[i];
+        if (std::abs(acc) >= std::abs(src[i])) {
+            c += (acc - t) + src[i];
+        } else {
+            c += (src[i] - t) + acc;
+        }
+        acc = t;
+    }
+    return acc + c;
 }
 
-cl::Program createProgram(cl::Context& context, const std::vector<cl::Device>& devices, const std::string& filename)
+// Pairwise sum, as pzc_sum_pairwise. The error grows with log(n).
+double cpuSumPairwise(const double* src, size_t num)
 {
-    std::ifstream file;
-    file.open(filename, std::ios::in | std::ios::binary);
-
-    if (file.fail()) {
-        throw "can not open kernel file";
+    if (num <= 8) {
+        double acc = 0.0;
+        for (size_t i = 0; i < num; ++i) {
+            acc += src[i];
+        }
+        return acc;
     }
-
-    size_t            filesize = getFileSize(file);
-    std::vector<char> binary_data;
-    loadFile(file, binary_data, filesize);
-
-    cl::Program::Binaries binaries;
-    binaries.push_back(std::make_pair(&binary_data[0], filesize));
-
-    return cl::Program(context, devices, binaries, nullptr, nullptr);
+    const size_t half = num / 2;
+    return cpuSumPairwise(src, half) + cpuSumPairwise(src + half, num - half);
 }
 
-cl::Program createProgram(cl::Context& context, const cl::Device& device, const std::string& filename)
+// Same block size and lanes as pzc_sum_deterministic.
+constexpr size_t DETERMINISTIC_BLOCK = 1024;
+constexpr size_t DETERMINISTIC_LANES = 8;
+
+size_t deterministicBlocks(size_t num)
 {
-    std::vector<cl::Device> devices { device };
-    return createProgram(context, devices, filename);
+    return (num + DETERMINISTIC_BLOCK - 1) / DETERMINISTIC_BLOCK;
 }
 
-void getBasicDeviceInfo(const cl::Device& device, std::string& device_name, size_t& global_work_size)
+// Host version of pzc_sum_deterministic. It makes the same additions in the
+// same order, so it gives the bits of the device result.
+double cpuSumDeterministic(const std::vector<double>& src)
 {
-    device.getInfo(CL_DEVICE_NAME, &device_name);
-
-    size_t global_work_size_[3] = { 0 };
-    device.getInfo(CL_DEVICE_MAX_WORK_ITEM_SIZES, &global_work_size_);
+    const size_t        num    = src.size();
+    const size_t        blocks = deterministicBlocks(num);
+    std::vector<double> partial(blocks);
+
+    for (size_t b = 0; b < blocks; ++b) {
+        const size_t begin = b * DETERMINISTIC_BLOCK;
+        const size_t end   = std::min(begin + DETERMINISTIC_BLOCK, num);
+
+        double lane[DETERMINISTIC_LANES] = {};
+        for (size_t i = begin; i < end; i += DETERMINISTIC_LANES) {
+            for (size_t j = 0; j < DETERMINISTIC_LANES && i + j < end; ++j) {
+                lane[j] += src[i + j];
+            }
+        }
+        partial[b] = ((lane[0] + lane[1]) + (lane[2] + lane[3])) + ((lane[4] + lane[5]) + (lane[6] + lane[7]));
+    }
 
-    global_work_size = global_work_size_[0];
-    if (device_name.find("PEZY-SC2") != std::string::npos) {
-        global_work_size = std::min(global_work_size, (size_t)15872);
+    for (size_t stride = 1; stride < blocks; stride *= 8) {
+        for (size_t b = 0; b < blocks; b += 8 * stride) {
+            double acc = partial[b];
+            for (size_t j = 1; j < 8 && b + j * stride < blocks; ++j) {
+                acc += partial[b + j * stride];
+            }
+            partial[b] = acc;
+        }
     }
+    return blocks > 0 ? partial[0] : 0.0;
 }
 
-void benchmarkSum(const std::vector<double>& src)
+struct SumKernel {
+    std::string name;
+    double      expected;
+    double      tolerance; // relative error allowed, 0 for identical bits
+};
+
+// Returns false if a kernel misses its expected sum.
+bool benchmarkSum(const std::vector<double>& src)
 {
-    const size_t                   loop_count   = 20;
-    const double                   expected     = cpuSum(src);
-    const std::vector<std::string> kernel_names = { "sum_simple", "sum_base2", "sum_base4", "sum_base8" };
+    const size_t loop_count = 20;
+    bool         ok         = true;
+
+    // The compensated sum is the reference; the others show how far the
+    // plain orders of summation drift from it.
+    const double reference = cpuSumKahan(src);
+    std::printf("cpu kahan    = %24.16e\n", reference);
+    std::printf("cpu pairwise = %24.16e\n", cpuSumPairwise(src.data(), src.size()));
+    std::printf("cpu naive    = %24.16e\n", cpuSum(src));
+
+    // The deterministic kernel must match its host version bit for bit.
+    const std::vector<SumKernel> kernels = {
+        { "sum_simple", reference, 1e-8 },
+        { "sum_base2", reference, 1e-8 },
+        { "sum_base4", reference, 1e-8 },
+        { "sum_base8", reference, 1e-8 },
+        { "sum_kahan", reference, 1e-14 },
+        { "sum_pairwise", reference, 1e-12 },
+        { "sum_deterministic", cpuSumDeterministic(src), 0.0 },
+    };
 
     try {
-        // Get Platform
-        std::vector<cl::Platform> platforms;
-        cl::Platform::get(&platforms);
-        const auto& Platform = platforms[0];
-
-        // Get devices
-        std::vector<cl::Device> devices;
-        Platform.getDevices(CL_DEVICE_TYPE_DEFAULT, &devices);
-
-        // Use first device.
-        const auto& device = devices[0];
-
-        // Create Context.
-        auto context = cl::Context(device);
-
-        // Create CommandQueue (enable profiling).
-        auto command_queue = cl::CommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE);
-
-        // Create Program.
-        // Load compiled binary file and create cl::Program object.
-        auto program = createProgram(context, device, "kernel/kernel.pz");
+        // Check out Context, CommandQueue (enable profiling) and Program
+        // of first device. Only the first call creates them.
+        auto  device        = pzcl::DevicePool::instance().checkout(0, "kernel/kernel.pz", CL_QUEUE_PROFILING_ENABLE);
+        auto& context       = device->context;
+        auto& command_queue = device->queue;
 
         // Create Buffers.
         size_t num        = src.size();
         auto   device_src = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(double) * num);
         auto   device_dst = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(double));
 
+        // Block sums of sum_deterministic
+        auto device_partial = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(double) * std::max<size_t>(deterministicBlocks(num), 1));
+
         // Send src.
         command_queue.enqueueWriteBuffer(device_src, true, 0, sizeof(double) * num, &src[0]);
 
-        // Create kernel for flush
-        auto flush_kernel = cl::Kernel(program, "flush_LLC");
+        // Get kernel for flush
+        auto& flush_kernel = device->kernel("flush_LLC");
 
         // Get workitem size.
-        // sc1-64: 8192  (1024 PEs * 8 threads)
-        // sc2   : 15782 (1984 PEs * 8 threads)
-        std::string device_name      = "Unknown";
-        size_t      global_work_size = 0;
-        getBasicDeviceInfo(device, device_name, global_work_size);
-        std::cout << "Use device : " << device_name << std::endl;
-        std::cout << "workitem   : " << global_work_size << std::endl;
-
-        for (const auto& kernel_name : kernel_names) {
-            // Create Kernel.
-            auto kernel = cl::Kernel(program, kernel_name.c_str());
+        const size_t global_work_size = device->global_work_size;
+        device->showDeviceInfo();
+
+        for (const auto& k : kernels) {
+            const std::string& kernel_name = k.name;
+            const double       expected    = k.expected;
+
+            // Get Kernel.
+            auto& kernel = device->kernel(kernel_name);
 
             // Set kernel args.
             kernel.setArg(0, device_dst);
             kernel.setArg(1, num);
             kernel.setArg(2, device_src);
+            if (kernel_name == "sum_deterministic") {
+                kernel.setArg(3, device_partial);
+            }
 
             double total_time = 0.0; // total elapsed time in nanoseconds
             bool   verify_ok  = true;
@@ -172,7 +207,7 @@ void benchmarkSum(const std::vector<double>& src)
 		}
 
                 // Check result
-                if (std::abs(expected - actual) / std::max(std::abs(expected), std::abs(actual)) > 1e-8) {
+                if (expected != actual && std::abs(expected - actual) / std::max(std::abs(expected), std::abs(actual)) > k.tolerance) {
                     std::cout << kernel_name << " failed:  expected: " << expected << "   actual: " << actual << std::endl;
                     verify_ok = false;
                     break;
@@ -198,7 +233,263 @@ void benchmarkSum(const std::vector<double>& src)
                     std::printf("%s\t %10.4f ms\t %6d B \t %6.2f GB/s\n", kernel_name.c_str(), sec * 1000, static_cast<int>(bytes), bandwidth);
                 }
             }
+            ok = verify_ok && ok;
         }
+        return ok;
+    } catch (const cl::Error& e) {
+        std::stringstream msg;
+        msg << "CL Error : " << e.what() << " " << e.err();
+        throw std::runtime_error(msg.str());
+    }
+}
+
+template <typename T>
+std::vector<T> randomVector(size_t num, T lo, T hi)
+{
+    typedef typename std::conditional<std::is_integral<T>::value, std::uniform_int_distribution<T>, std::uniform_real_distribution<T>>::type Distribution;
+
+    Distribution   rnd(lo, hi);
+    std::vector<T> v(num);
+    for (auto& x : v) {
+        x = rnd(mt);
+    }
+    return v;
+}
+
+template <typename T>
+bool sameSum(T expected, T actual)
+{
+    return expected == actual;
+}
+
+bool sameSum(float expected, float actual)
+{
+    return std::abs(expected - actual) <= 1e-5 * std::max(std::abs(expected), std::abs(actual));
+}
+
+bool sameSum(double expected, double actual)
+{
+    return std::abs(expected - actual) <= 1e-8 * std::max(std::abs(expected), std::abs(actual));
+}
+
+// Runs every reduction of Reducer on src and checks it against the host.
+template <typename T>
+bool checkReducer(pzcl::PooledDevice& device, Reducer& reducer, const std::vector<T>& src)
+{
+    const size_t num        = src.size();
+    auto         pooled_src = device.buffers->acquire(sizeof(T) * std::max<size_t>(num, 1));
+    auto&        device_src = pooled_src.get();
+    if (num > 0) {
+        device.queue.enqueueWriteBuffer(device_src, true, 0, sizeof(T) * num, &src[0]);
+    }
+
+    // Floating point sums are checked against a double sum, integer sums
+    // must be exact.
+    typename std::conditional<std::is_integral<T>::value, long, double>::type expected_sum = 0;
+    for (auto x : src) {
+        expected_sum += x;
+    }
+    // min_element and max_element give the first of equal elements, as
+    // argmin and argmax do.
+    const auto   min_it = std::min_element(src.begin(), src.end());
+    const auto   max_it = std::max_element(src.begin(), src.end());
+    const bool   all    = std::all_of(src.begin(), src.end(), [](T x) { return x != 0; });
+    const bool   any    = std::any_of(src.begin(), src.end(), [](T x) { return x != 0; });
+    const char*  type   = pzcl::TypeName<T>::get();
+    bool         ok     = true;
+    auto         check  = [&](const char* op, bool result) {
+        if (!result) {
+            std::cout << "reduce_" << op << "_" << type << " failed" << std::endl;
+            ok = false;
+        }
+    };
+
+    check("sum", sameSum(static_cast<typename SumType<T>::type>(expected_sum), reducer.sum<T>(device_src, num)));
+    check("all", reducer.all<T>(device_src, num) == all);
+    check("any", reducer.any<T>(device_src, num) == any);
+    if (num > 0) {
+        const auto argmin = reducer.argmin<T>(device_src, num);
+        const auto argmax = reducer.argmax<T>(device_src, num);
+        check("min", reducer.min<T>(device_src, num) == *min_it);
+        check("max", reducer.max<T>(device_src, num) == *max_it);
+        check("argmin", argmin.value == *min_it && argmin.index == min_it - src.begin());
+        check("argmax", argmax.value == *max_it && argmax.index == max_it - src.begin());
+    }
+
+    std::cout << "reduce " << type << "\t" << (ok ? "PASS" : "FAIL") << std::endl;
+    return ok;
+}
+
+bool testReducer(size_t num)
+{
+    try {
+        auto    device = pzcl::DevicePool::instance().checkout(0, "kernel/kernel.pz");
+        Reducer reducer(*device);
+
+        bool ok = true;
+        ok      = checkReducer(*device, reducer, randomVector<float>(num, 0.0f, 1.0f)) && ok;
+        ok      = checkReducer(*device, reducer, randomVector<double>(num, 0.0, 1.0)) && ok;
+        ok      = checkReducer(*device, reducer, randomVector<int>(num, -1000, 1000)) && ok;
+        ok      = checkReducer(*device, reducer, randomVector<long>(num, -1000000, 1000000)) && ok;
+        return ok;
+    } catch (const cl::Error& e) {
+        std::stringstream msg;
+        msg << "CL Error : " << e.what() << " " << e.err();
+        throw std::runtime_error(msg.str());
+    }
+}
+
+template <typename T>
+std::vector<T> cpuScan(const std::vector<T>& src, bool inclusive)
+{
+    std::vector<T> dst(src.size());
+    T              acc = 0;
+    for (size_t i = 0; i < src.size(); ++i) {
+        if (inclusive) {
+            acc += src[i];
+            dst[i] = acc;
+        } else {
+            dst[i] = acc;
+            acc += src[i];
+        }
+    }
+    return dst;
+}
+
+// Inclusive and exclusive scans of src on the device, against the host.
+template <typename T>
+bool checkScan(pzcl::PooledDevice& device, Reducer& reducer, const std::vector<T>& src)
+{
+    const size_t num        = src.size();
+    auto         pooled_src = device.buffers->acquire(sizeof(T) * std::max<size_t>(num, 1));
+    auto         pooled_dst = device.buffers->acquire(sizeof(T) * std::max<size_t>(num, 1));
+    if (num > 0) {
+        device.queue.enqueueWriteBuffer(pooled_src.get(), true, 0, sizeof(T) * num, &src[0]);
+    }
+
+    bool ok = true;
+    for (bool inclusive : { true, false }) {
+        if (inclusive) {
+            reducer.inclusiveScan<T>(pooled_src.get(), pooled_dst.get(), num);
+        } else {
+            reducer.exclusiveScan<T>(pooled_src.get(), pooled_dst.get(), num);
+        }
+        std::vector<T> actual(num);
+        if (num > 0) {
+            device.queue.enqueueReadBuffer(pooled_dst.get(), true, 0, sizeof(T) * num, &actual[0]);
+        }
+
+        // Floating point prefixes differ from the host only by rounding.
+        const std::vector<T> expected = cpuScan(src, inclusive);
+        for (size_t i = 0; i < num; ++i) {
+            if (expected[i] != actual[i] && std::abs(expected[i] - actual[i]) > 1e-10 * std::abs(expected[i])) {
+                std::cout << (inclusive ? "scan_inclusive_" : "scan_exclusive_") << pzcl::TypeName<T>::get() << " failed at " << i
+                          << ":  expected: " << expected[i] << "   actual: " << actual[i] << std::endl;
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    std::cout << "scan " << pzcl::TypeName<T>::get() << "\t" << (ok ? "PASS" : "FAIL") << std::endl;
+    return ok;
+}
+
+bool testScan(size_t num)
+{
+    try {
+        auto    device = pzcl::DevicePool::instance().checkout(0, "kernel/kernel.pz");
+        Reducer reducer(*device);
+
+        bool ok = true;
+        ok      = checkScan(*device, reducer, randomVector<double>(num, 0.0, 1.0)) && ok;
+        ok      = checkScan(*device, reducer, randomVector<int>(num, -1000, 1000)) && ok;
+        ok      = checkScan(*device, reducer, randomVector<long>(num, -1000000, 1000000)) && ok;
+        return ok;
+    } catch (const cl::Error& e) {
+        std::stringstream msg;
+        msg << "CL Error : " << e.what() << " " << e.err();
+        throw std::runtime_error(msg.str());
+    }
+}
+
+// Sums of count segments of src at random cut points, in one batched launch
+// of each kind and in one launch per segment.
+bool benchmarkBatched(const std::vector<double>& src, size_t count)
+{
+    const size_t num = src.size();
+
+    std::vector<size_t>                   offsets(count + 1);
+    std::uniform_int_distribution<size_t> rnd(0, num);
+    for (size_t k = 1; k < count; ++k) {
+        offsets[k] = rnd(mt);
+    }
+    offsets[count] = num;
+    std::sort(offsets.begin(), offsets.end());
+
+    std::vector<double> expected(count, 0.0);
+    for (size_t k = 0; k < count; ++k) {
+        for (size_t i = offsets[k]; i < offsets[k + 1]; ++i) {
+            expected[k] += src[i];
+        }
+    }
+    auto verify = [&](const std::vector<double>& actual) {
+        for (size_t k = 0; k < count; ++k) {
+            if (expected[k] != actual[k] && std::abs(expected[k] - actual[k]) / std::max(std::abs(expected[k]), std::abs(actual[k])) > 1e-12) {
+                std::cout << "segment " << k << " failed:  expected: " << expected[k] << "   actual: " << actual[k] << std::endl;
+                return false;
+            }
+        }
+        return true;
+    };
+
+    try {
+        auto    device = pzcl::DevicePool::instance().checkout(0, "kernel/kernel.pz");
+        Reducer reducer(*device);
+
+        // All segments in one buffer, with the offset table
+        auto pooled_src     = device->buffers->acquire(sizeof(double) * std::max<size_t>(num, 1));
+        auto pooled_offsets = device->buffers->acquire(sizeof(size_t) * (count + 1));
+        if (num > 0) {
+            device->queue.enqueueWriteBuffer(pooled_src.get(), true, 0, sizeof(double) * num, &src[0]);
+        }
+        device->queue.enqueueWriteBuffer(pooled_offsets.get(), true, 0, sizeof(size_t) * (count + 1), &offsets[0]);
+
+        // Every segment in a buffer of its own
+        std::vector<pzcl::BufferPool::Buffer> segments;
+        for (size_t k = 0; k < count; ++k) {
+            const size_t n = offsets[k + 1] - offsets[k];
+            segments.push_back(device->buffers->acquire(sizeof(double) * std::max<size_t>(n, 1)));
+            if (n > 0) {
+                device->queue.enqueueWriteBuffer(segments.back().get(), true, 0, sizeof(double) * n, &src[offsets[k]]);
+            }
+        }
+
+        // Warm up: create the kernels
+        reducer.sum<double>(pooled_src.get(), pooled_offsets.get(), count);
+        reducer.sum<double>(pooled_src.get(), pooled_offsets.get(), count, Reducer::Segments::Large);
+        reducer.sum<double>(segments[0].get(), offsets[1] - offsets[0]);
+
+        auto                batched_start = std::chrono::steady_clock::now();
+        std::vector<double> batched       = reducer.sum<double>(pooled_src.get(), pooled_offsets.get(), count);
+        auto                batched_end   = std::chrono::steady_clock::now();
+
+        auto                segmented_start = std::chrono::steady_clock::now();
+        std::vector<double> segmented       = reducer.sum<double>(pooled_src.get(), pooled_offsets.get(), count, Reducer::Segments::Large);
+        auto                segmented_end   = std::chrono::steady_clock::now();
+
+        std::vector<double> separate(count);
+        auto                separate_start = std::chrono::steady_clock::now();
+        for (size_t k = 0; k < count; ++k) {
+            separate[k] = reducer.sum<double>(segments[k].get(), offsets[k + 1] - offsets[k]);
+        }
+        auto separate_end = std::chrono::steady_clock::now();
+
+        const bool ok = verify(batched) && verify(segmented) && verify(separate);
+        std::printf("batched   %6zu segments\t %10.4f ms\n", count, std::chrono::duration<double, std::milli>(batched_end - batched_start).count());
+        std::printf("segmented %6zu segments\t %10.4f ms\n", count, std::chrono::duration<double, std::milli>(segmented_end - segmented_start).count());
+        std::printf("separate  %6zu launches\t %10.4f ms\n", count, std::chrono::duration<double, std::milli>(separate_end - separate_start).count());
+        return ok;
     } catch (const cl::Error& e) {
         std::stringstream msg;
         msg << "CL Error : " << e.what() << " " << e.err();
@@ -221,7 +512,16 @@ int main(int argc, char** argv)
     std::vector<double> src(num);
     initVector(src);
 
-    benchmarkSum(src);
-
-    return 0;
+    bool ok = benchmarkSum(src);
+    ok      = testReducer(num) && ok;
+    ok      = testScan(num) && ok;
+    ok      = benchmarkBatched(src, 1024) && ok;
+
+    if (ok) {
+        std::cout << "PASS" << std::endl;
+        return 0;
+    } else {
+        std::cout << "FAIL" << std::endl;
+        return 1;
+    }
 }
@@ -0,0 +1,67 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "reducer.hpp"
+
+namespace {
+// Largest result of any reduction, ArgValue<double>
+constexpr size_t MAX_RESULT_SIZE = 16;
+}
+
+Reducer::Reducer(pzcl::PooledDevice& device_)
+    : device(device_)
+    , device_result(device_.buffers->acquire(MAX_RESULT_SIZE))
+{
+}
+
+void Reducer::launch(const std::string& kernel_name, const cl::Buffer& data, size_t num, void* result, size_t size)
+{
+    // Get Kernel.
+    auto& kernel = device.kernel(kernel_name);
+
+    // Set kernel args.
+    kernel.setArg(0, device_result.get());
+    kernel.setArg(1, num);
+    kernel.setArg(2, data);
+
+    // Run kernel and get result.
+    device.queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(device.global_work_size), cl::NullRange, nullptr, nullptr);
+    device.queue.enqueueReadBuffer(device_result.get(), true, 0, size, result);
+}
+
+void Reducer::launchBatched(const std::string& kernel_name, const cl::Buffer& data, const cl::Buffer& offsets, size_t count, void* result, size_t size)
+{
+    if (count == 0) {
+        return;
+    }
+    auto pooled_result = device.buffers->acquire(size * count);
+
+    // Get Kernel.
+    auto& kernel = device.kernel(kernel_name);
+
+    // Set kernel args.
+    kernel.setArg(0, pooled_result.get());
+    kernel.setArg(1, count);
+    kernel.setArg(2, offsets);
+    kernel.setArg(3, data);
+
+    // Run kernel and get results.
+    device.queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(device.global_work_size), cl::NullRange, nullptr, nullptr);
+    device.queue.enqueueReadBuffer(pooled_result.get(), true, 0, size * count, result);
+}
+
+void Reducer::launchScan(const std::string& kernel_name, const cl::Buffer& src, cl::Buffer& dst, size_t num)
+{
+    // Get Kernel.
+    auto& kernel = device.kernel(kernel_name);
+
+    // Set kernel args.
+    kernel.setArg(0, dst);
+    kernel.setArg(1, src);
+    kernel.setArg(2, num);
+
+    device.queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(device.global_work_size), cl::NullRange, nullptr, nullptr);
+}
@@ -0,0 +1,197 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Typed reductions of device buffers
+ * @details   Sum, min, max, argmin, argmax, all and any over float, double,
+ *            int and long arrays that are already on the device, with the
+ *            pzc_reduce_<op>_<type> kernels of kernel.pzc. Only the result
+ *            comes back to the host.
+ *            The batched overloads reduce many segments of one buffer in a
+ *            single launch, for workloads of many small reductions where
+ *            one launch per reduction would dominate. Prefix sums (scans)
+ *            run on the device too.
+ */
+
+#ifndef REDUCER_HPP
+#define REDUCER_HPP
+
+#include "pzcl_device_pool.hpp"
+#include "pzcl_specialization.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Sum type of T, as SumType in kernel.pzc: int is summed in long.
+template <typename T>
+struct SumType {
+    typedef T type;
+};
+
+template <>
+struct SumType<int> {
+    typedef long type;
+};
+
+// Result of argmin and argmax, laid out as ArgValue in kernel.pzc.
+// index is the lowest index holding value.
+template <typename T>
+struct ArgValue {
+    T    value;
+    long index;
+};
+
+class Reducer {
+public:
+    // Runs on the queue of device. The device must have the program of
+    // this sample.
+    explicit Reducer(pzcl::PooledDevice& device);
+
+    // data holds num elements of T.
+    template <typename T>
+    typename SumType<T>::type sum(const cl::Buffer& data, size_t num)
+    {
+        return run<typename SumType<T>::type, T>("sum", data, num);
+    }
+
+    template <typename T>
+    T min(const cl::Buffer& data, size_t num)
+    {
+        return run<T, T>("min", data, num);
+    }
+
+    template <typename T>
+    T max(const cl::Buffer& data, size_t num)
+    {
+        return run<T, T>("max", data, num);
+    }
+
+    template <typename T>
+    ArgValue<T> argmin(const cl::Buffer& data, size_t num)
+    {
+        return run<ArgValue<T>, T>("argmin", data, num);
+    }
+
+    template <typename T>
+    ArgValue<T> argmax(const cl::Buffer& data, size_t num)
+    {
+        return run<ArgValue<T>, T>("argmax", data, num);
+    }
+
+    // True if every element is non-zero (or num is 0).
+    template <typename T>
+    bool all(const cl::Buffer& data, size_t num)
+    {
+        return run<int, T>("all", data, num) != 0;
+    }
+
+    // True if any element is non-zero.
+    template <typename T>
+    bool any(const cl::Buffer& data, size_t num)
+    {
+        return run<int, T>("any", data, num) != 0;
+    }
+
+    // How batched reductions share out the work.
+    enum class Segments {
+        Small, // one PE per segment, for many short segments
+        Large, // all threads over the whole array, for long or uneven ones
+    };
+
+    // Batched: offsets holds count + 1 size_t, and segment k of data is
+    // elements offsets[k] to offsets[k + 1] - 1. Returns one result per
+    // segment. Indices of argmin and argmax are within the segment; an
+    // empty segment gives the identity, with index LONG_MAX.
+    template <typename T>
+    std::vector<typename SumType<T>::type> sum(const cl::Buffer& data, const cl::Buffer& offsets, size_t count, Segments segments = Segments::Small)
+    {
+        return runBatched<typename SumType<T>::type, T>("sum", data, offsets, count, segments);
+    }
+
+    template <typename T>
+    std::vector<T> min(const cl::Buffer& data, const cl::Buffer& offsets, size_t count, Segments segments = Segments::Small)
+    {
+        return runBatched<T, T>("min", data, offsets, count, segments);
+    }
+
+    template <typename T>
+    std::vector<T> max(const cl::Buffer& data, const cl::Buffer& offsets, size_t count, Segments segments = Segments::Small)
+    {
+        return runBatched<T, T>("max", data, offsets, count, segments);
+    }
+
+    template <typename T>
+    std::vector<ArgValue<T>> argmin(const cl::Buffer& data, const cl::Buffer& offsets, size_t count, Segments segments = Segments::Small)
+    {
+        return runBatched<ArgValue<T>, T>("argmin", data, offsets, count, segments);
+    }
+
+    template <typename T>
+    std::vector<ArgValue<T>> argmax(const cl::Buffer& data, const cl::Buffer& offsets, size_t count, Segments segments = Segments::Small)
+    {
+        return runBatched<ArgValue<T>, T>("argmax", data, offsets, count, segments);
+    }
+
+    // Non-zero where every element of the segment is non-zero.
+    template <typename T>
+    std::vector<int> all(const cl::Buffer& data, const cl::Buffer& offsets, size_t count, Segments segments = Segments::Small)
+    {
+        return runBatched<int, T>("all", data, offsets, count, segments);
+    }
+
+    // Non-zero where any element of the segment is non-zero.
+    template <typename T>
+    std::vector<int> any(const cl::Buffer& data, const cl::Buffer& offsets, size_t count, Segments segments = Segments::Small)
+    {
+        return runBatched<int, T>("any", data, offsets, count, segments);
+    }
+
+    // dst[i] = src[0] + ... + src[i], for num elements of T. dst may be
+    // src. The scan is only enqueued; later commands on the queue of the
+    // device see its result.
+    template <typename T>
+    void inclusiveScan(const cl::Buffer& src, cl::Buffer& dst, size_t num)
+    {
+        launchScan(std::string("scan_inclusive_") + pzcl::TypeName<T>::get(), src, dst, num);
+    }
+
+    // dst[i] = src[0] + ... + src[i - 1], dst[0] = 0.
+    template <typename T>
+    void exclusiveScan(const cl::Buffer& src, cl::Buffer& dst, size_t num)
+    {
+        launchScan(std::string("scan_exclusive_") + pzcl::TypeName<T>::get(), src, dst, num);
+    }
+
+private:
+    template <typename R, typename T>
+    R run(const std::string& op, const cl::Buffer& data, size_t num)
+    {
+        R result;
+        launch("reduce_" + op + "_" + pzcl::TypeName<T>::get(), data, num, &result, sizeof(R));
+        return result;
+    }
+
+    template <typename R, typename T>
+    std::vector<R> runBatched(const std::string& op, const cl::Buffer& data, const cl::Buffer& offsets, size_t count, Segments segments)
+    {
+        const std::string kind = segments == Segments::Small ? "reduce_batched_" : "reduce_segmented_";
+
+        std::vector<R> result(count);
+        launchBatched(kind + op + "_" + pzcl::TypeName<T>::get(), data, offsets, count, result.data(), sizeof(R));
+        return result;
+    }
+
+    // Runs kernel_name and reads size bytes of its result to result.
+    void launch(const std::string& kernel_name, const cl::Buffer& data, size_t num, void* result, size_t size);
+
+    // Runs kernel_name and reads count results of size bytes to result.
+    void launchBatched(const std::string& kernel_name, const cl::Buffer& data, const cl::Buffer& offsets, size_t count, void* result, size_t size);
+
+    // Enqueues kernel_name over num elements of src into dst.
+    void launchScan(const std::string& kernel_name, const cl::Buffer& src, cl::Buffer& dst, size_t num);
+
+    pzcl::PooledDevice&      device;
+    pzcl::BufferPool::Buffer device_result;
+};
+
+#endif
@@ -4,10 +4,8 @@
  * @copyright BSD-3-Clause
  */
 
-#define __CL_ENABLE_EXCEPTIONS
-#include <CL/cl.hpp>
+#include "pzcl_runtime.hpp"
 #include <cassert>
-#include <fstream>
 #include <iostream>
 #include <random>
 #include <sstream>
@@ -37,68 +35,27 @@ void cpuAdd(size_t num, std::vector<double>& dst, const std::vector<double>& src
     }
 }
 
-cl::Program createProgram(cl::Context& context, const std::vector<cl::Device>& devices, const std::string& binary_data)
-{
-    cl::Program::Binaries binaries;
-    binaries.push_back(std::make_pair(&binary_data[0], binary_data.size()));
-
-    return cl::Program(context, devices, binaries, nullptr, nullptr);
-}
-
-cl::Program createProgram(cl::Context& context, const cl::Device& device, const std::string& binary_data)
-{
-    std::vector<cl::Device> devices { device };
-    return createProgram(context, devices, binary_data);
-}
-
 void pzcAdd(size_t num, std::vector<double>& dst, const std::vector<double>& src0, const std::vector<double>& src1)
 {
     try {
-        // Get Platform
-        std::vector<cl::Platform> platforms;
-        cl::Platform::get(&platforms);
-        const auto& Platform = platforms[0];
-
-        // Get devices
-        std::vector<cl::Device> devices;
-        Platform.getDevices(CL_DEVICE_TYPE_DEFAULT, &devices);
-
-        // Use first device.
-        const auto& device = devices[0];
-
-        // Create Context.
-        auto context = cl::Context(device);
-
-        // Create CommandQueue.
-        auto command_queue = cl::CommandQueue(context, device, 0);
+        // Create Context and CommandQueue on first device.
+        pzcl::Runtime runtime(0);
+        auto&         context       = runtime.context;
+        auto&         command_queue = runtime.queue;
 
         // Get workitem size and kernel binary.
-        // sc1-64: 8192  (1024 PEs * 8 threads)
-        // sc2   : 15782 (1984 PEs * 8 threads)
-        size_t      global_work_size = 0;
-        std::string kernel_binary    = "";
-        {
-            std::string device_name;
-            device.getInfo(CL_DEVICE_NAME, &device_name);
-
-            size_t global_work_size_[3] = { 0 };
-            device.getInfo(CL_DEVICE_MAX_WORK_ITEM_SIZES, &global_work_size_);
-
-            global_work_size = global_work_size_[0];
-            if (device_name.find("PEZY-SC2") != std::string::npos) {
-                global_work_size = std::min(global_work_size, (size_t)15872);
-                kernel_binary    = std::string(_binary_kernel_sc2_pz_start, _binary_kernel_sc2_pz_end - _binary_kernel_sc2_pz_start);
-            } else {
-                kernel_binary = std::string(_binary_kernel_sc1_64_pz_start, _binary_kernel_sc1_64_pz_end - _binary_kernel_sc1_64_pz_start);
-            }
-
-            std::cout << "Use device : " << device_name << std::endl;
-            std::cout << "workitem   : " << global_work_size << std::endl;
+        const size_t global_work_size = runtime.global_work_size;
+        const char*  binary_start     = _binary_kernel_sc1_64_pz_start;
+        const char*  binary_end       = _binary_kernel_sc1_64_pz_end;
+        if (runtime.device_name.find("PEZY-SC2") != std::string::npos) {
+            binary_start = _binary_kernel_sc2_pz_start;
+            binary_end   = _binary_kernel_sc2_pz_end;
         }
+        runtime.showDeviceInfo();
 
         // Create Program.
-        // Load compiled binary file and create cl::Program object.
-        auto program = createProgram(context, device, kernel_binary);
+        // Use embedded binary in place and create cl::Program object.
+        auto program = pzcl::createProgram(context, { runtime.device }, binary_start, binary_end - binary_start);
 
         // Create Kernel.
         // Give kernel name without pzc_ prefix.
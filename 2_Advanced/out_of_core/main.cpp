@@ -0,0 +1,309 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "pzcl_device_pool.hpp"
+#include "pzcl_out_of_core.hpp"
+#include "pzcl_pipeline.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+// Windows in flight: one uploads while the previous one computes.
+constexpr size_t DEPTH = 2;
+
+std::mt19937 mt(0);
+
+// Writes num random doubles to filename, a block at a time.
+void createInput(const std::string& filename, size_t num)
+{
+    std::uniform_real_distribution<> rnd01(0.0, 1.0);
+    std::ofstream                    file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    std::vector<double>              block(1 << 20);
+
+    for (size_t offset = 0; offset < num; offset += block.size()) {
+        const size_t n = std::min(block.size(), num - offset);
+        for (size_t i = 0; i < n; ++i) {
+            block[i] = rnd01(mt);
+        }
+        file.write(reinterpret_cast<const char*>(&block[0]), sizeof(double) * n);
+    }
+    if (!file) {
+        throw std::runtime_error("can not write " + filename);
+    }
+}
+
+// Input file as an array of doubles, read front to back.
+// With lock, its pages are locked for transfers of the device context.
+class InputArray {
+public:
+    explicit InputArray(const std::string& filename)
+        : file(new pzcl::MappedInputFile(filename))
+    {
+    }
+
+    InputArray(const std::string& filename, const pzcl::PooledDevice& device, bool lock)
+        : file(lock ? new pzcl::MappedInputFile(filename, device.context) : new pzcl::MappedInputFile(filename))
+    {
+    }
+
+    const double* data() const { return static_cast<const double*>(file->data()); }
+    size_t        size() const { return file->size() / sizeof(double); }
+
+    // Enqueues a write of one window to buf straight from the mapping, and
+    // starts reading the next window from the file meanwhile.
+    cl::Event upload(cl::CommandQueue& queue, cl::Buffer& buf, const pzcl::Pipeline::Chunk& c, const std::vector<cl::Event>& wait) const
+    {
+        file->prefetch(sizeof(double) * (c.offset + c.size), sizeof(double) * c.size);
+        return file->enqueueWrite(queue, buf, sizeof(double) * c.offset, sizeof(double) * c.size, wait);
+    }
+
+private:
+    std::unique_ptr<pzcl::MappedInputFile> file;
+};
+
+cl::Event runKernel(pzcl::PooledDevice& device, cl::Kernel& kernel, cl::CommandQueue& queue, const std::vector<cl::Event>& wait)
+{
+    cl::Event event;
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(device.global_work_size), cl::NullRange, &wait, &event);
+    return event;
+}
+
+cl::Event downloadWindow(cl::CommandQueue& queue, cl::Buffer& buf, double* dst, const pzcl::Pipeline::Chunk& c, const std::vector<cl::Event>& wait)
+{
+    cl::Event event;
+    queue.enqueueReadBuffer(buf, false, 0, sizeof(double) * c.size, dst + c.offset, &wait, &event);
+    return event;
+}
+
+// Device buffers of `arrays` window-sized arrays for each slot.
+std::vector<pzcl::BufferPool::Buffer> acquireWindows(pzcl::PooledDevice& device, size_t arrays, size_t window)
+{
+    std::vector<pzcl::BufferPool::Buffer> buffers;
+    for (size_t i = 0; i < arrays * DEPTH; ++i) {
+        buffers.push_back(device.buffers->acquire(sizeof(double) * window));
+    }
+    return buffers;
+}
+
+// dst file = src0 file + src1 file
+void addFiles(const std::string& src0_file, const std::string& src1_file, const std::string& dst_file, size_t window, bool lock)
+{
+    auto  device = pzcl::DevicePool::instance().checkout(0, "kernel/kernel.pz");
+    auto& kernel = device->kernel("add");
+
+    InputArray             src0(src0_file, *device, lock);
+    InputArray             src1(src1_file, *device, lock);
+    const size_t           num = src0.size();
+    pzcl::MappedOutputFile dst_map(dst_file, sizeof(double) * num);
+    double*                dst = static_cast<double*>(dst_map.data());
+
+    pzcl::Pipeline pipeline(device->context, device->device, DEPTH);
+    auto           buffers = acquireWindows(*device, 3, window);
+    auto           buffer  = [&](size_t slot, size_t i) -> cl::Buffer& { return buffers[3 * slot + i].get(); };
+
+    pipeline.run(
+        num, window,
+        [&](const pzcl::Pipeline::Chunk& c, cl::CommandQueue& queue, const std::vector<cl::Event>& wait) {
+            src0.upload(queue, buffer(c.slot, 0), c, wait);
+            return src1.upload(queue, buffer(c.slot, 1), c, {});
+        },
+        [&](const pzcl::Pipeline::Chunk& c, cl::CommandQueue& queue, const std::vector<cl::Event>& wait) {
+            kernel.setArg(0, c.size);
+            kernel.setArg(1, buffer(c.slot, 2));
+            kernel.setArg(2, buffer(c.slot, 0));
+            kernel.setArg(3, buffer(c.slot, 1));
+            return runKernel(*device, kernel, queue, wait);
+        },
+        [&](const pzcl::Pipeline::Chunk& c, cl::CommandQueue& queue, const std::vector<cl::Event>& wait) {
+            return downloadWindow(queue, buffer(c.slot, 2), dst, c, wait);
+        });
+}
+
+// a file = b file + scalar * c file
+void triadFiles(const std::string& a_file, const std::string& b_file, const std::string& c_file, double scalar, size_t window, bool lock)
+{
+    auto  device = pzcl::DevicePool::instance().checkout(0, "kernel/kernel.pz");
+    auto& kernel = device->kernel("triad");
+
+    InputArray             b(b_file, *device, lock);
+    InputArray             c(c_file, *device, lock);
+    const size_t           num = b.size();
+    pzcl::MappedOutputFile a_map(a_file, sizeof(double) * num);
+    double*                a = static_cast<double*>(a_map.data());
+
+    pzcl::Pipeline pipeline(device->context, device->device, DEPTH);
+    auto           buffers = acquireWindows(*device, 3, window);
+    auto           buffer  = [&](size_t slot, size_t i) -> cl::Buffer& { return buffers[3 * slot + i].get(); };
+
+    pipeline.run(
+        num, window,
+        [&](const pzcl::Pipeline::Chunk& w, cl::CommandQueue& queue, const std::vector<cl::Event>& wait) {
+            b.upload(queue, buffer(w.slot, 1), w, wait);
+            return c.upload(queue, buffer(w.slot, 2), w, {});
+        },
+        [&](const pzcl::Pipeline::Chunk& w, cl::CommandQueue& queue, const std::vector<cl::Event>& wait) {
+            kernel.setArg(0, buffer(w.slot, 0));
+            kernel.setArg(1, buffer(w.slot, 1));
+            kernel.setArg(2, buffer(w.slot, 2));
+            kernel.setArg(3, scalar);
+            kernel.setArg(4, w.size);
+            return runKernel(*device, kernel, queue, wait);
+        },
+        [&](const pzcl::Pipeline::Chunk& w, cl::CommandQueue& queue, const std::vector<cl::Event>& wait) {
+            return downloadWindow(queue, buffer(w.slot, 0), a, w, wait);
+        });
+}
+
+// Sum of the src file. Each window adds its sum to one device value; the
+// compute queue runs the windows in order, so no two kernels race on it.
+double sumFile(const std::string& src_file, size_t window, bool lock)
+{
+    auto  device = pzcl::DevicePool::instance().checkout(0, "kernel/kernel.pz");
+    auto& kernel = device->kernel("sum");
+
+    InputArray src(src_file, *device, lock);
+
+    auto   pooled_sum = device->buffers->acquire(sizeof(double));
+    auto&  device_sum = pooled_sum.get();
+    double sum        = 0.0;
+    device->queue.enqueueWriteBuffer(device_sum, true, 0, sizeof(double), &sum);
+
+    pzcl::Pipeline pipeline(device->context, device->device, DEPTH);
+    auto           buffers = acquireWindows(*device, 1, window);
+
+    pipeline.run(
+        src.size(), window,
+        [&](const pzcl::Pipeline::Chunk& c, cl::CommandQueue& queue, const std::vector<cl::Event>& wait) {
+            return src.upload(queue, buffers[c.slot].get(), c, wait);
+        },
+        [&](const pzcl::Pipeline::Chunk& c, cl::CommandQueue& queue, const std::vector<cl::Event>& wait) {
+            kernel.setArg(0, device_sum);
+            kernel.setArg(1, c.size);
+            kernel.setArg(2, buffers[c.slot].get());
+            return runKernel(*device, kernel, queue, wait);
+        },
+        // Nothing to download per window: the slot is free once summed.
+        [&](const pzcl::Pipeline::Chunk&, cl::CommandQueue&, const std::vector<cl::Event>& wait) {
+            return wait.front();
+        });
+
+    device->queue.enqueueReadBuffer(device_sum, true, 0, sizeof(double), &sum);
+    return sum;
+}
+
+bool verifyArray(const std::string& name, const double* actual, const std::vector<const double*>& src, double scalar, size_t num)
+{
+    size_t error_count = 0;
+    for (size_t i = 0; i < num; ++i) {
+        const double expected = src[0][i] + scalar * src[1][i];
+        if (std::fabs(actual[i] - expected) > 1.e-7) {
+            if (error_count < 10) {
+                std::cerr << "# ERROR " << name << " " << i << " " << actual[i] << " " << expected << std::endl;
+            }
+            error_count++;
+        }
+    }
+    return error_count == 0;
+}
+}
+
+int main(int argc, char** argv)
+{
+    size_t num    = 1024;
+    size_t window = 0;     // 0: as large as the device allows
+    bool   lock   = false; // lock the input mappings, they must fit in memory
+
+    if (argc > 1) {
+        num = strtol(argv[1], nullptr, 10);
+    }
+    if (argc > 2) {
+        window = strtol(argv[2], nullptr, 10);
+    }
+    if (argc > 3) {
+        lock = strtol(argv[3], nullptr, 10) != 0;
+    }
+    num = std::max<size_t>(num, 1); // files of no element can not be mapped
+
+    const std::string src0_file = "ooc_src0.bin";
+    const std::string src1_file = "ooc_src1.bin";
+    const std::string dst_file  = "ooc_dst.bin";
+
+    bool ok = true;
+    try {
+        {
+            auto device = pzcl::DevicePool::instance().checkout(0, "kernel/kernel.pz");
+            device->showDeviceInfo();
+            if (window == 0) {
+                window = pzcl::getWindowSize(device->device, sizeof(double), 3, DEPTH);
+            }
+            window = std::max<size_t>(std::min(window, num), 1);
+        }
+
+        std::cout << "num        : " << num << std::endl;
+        std::cout << "window     : " << window << " (" << (num + window - 1) / window << " windows)" << std::endl;
+
+        createInput(src0_file, num);
+        createInput(src1_file, num);
+
+        const double scalar = 3.0;
+
+        // add
+        addFiles(src0_file, src1_file, dst_file, window, lock);
+        {
+            InputArray src0(src0_file), src1(src1_file), dst(dst_file);
+            ok = verifyArray("add", dst.data(), { src0.data(), src1.data() }, 1.0, num) && ok;
+        }
+
+        // STREAM Triad
+        triadFiles(dst_file, src0_file, src1_file, scalar, window, lock);
+        {
+            InputArray src0(src0_file), src1(src1_file), dst(dst_file);
+            ok = verifyArray("triad", dst.data(), { src0.data(), src1.data() }, scalar, num) && ok;
+        }
+
+        // reduction
+        {
+            const double actual = sumFile(src0_file, window, lock);
+
+            InputArray src0(src0_file);
+            double     expected = 0.0;
+            for (size_t i = 0; i < num; ++i) {
+                expected += src0.data()[i];
+            }
+            std::printf("expected = %24.16e\n", expected);
+            std::printf("actual   = %24.16e\n", actual);
+            if (std::fabs(expected - actual) / std::max(std::fabs(expected), std::fabs(actual)) > 1e-8) {
+                std::cerr << "sum failed" << std::endl;
+                ok = false;
+            }
+        }
+    } catch (const cl::Error& e) {
+        std::cerr << "CL Error : " << e.what() << " " << e.err() << std::endl;
+        ok = false;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        ok = false;
+    }
+
+    std::remove(src0_file.c_str());
+    std::remove(src1_file.c_str());
+    std::remove(dst_file.c_str());
+
+    if (ok) {
+        std::cout << "PASS" << std::endl;
+        return 0;
+    } else {
+        std::cout << "FAIL" << std::endl;
+        return 1;
+    }
+}
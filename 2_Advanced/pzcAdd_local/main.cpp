@@ -4,10 +4,8 @@
  * @copyright BSD-3-Clause
  */
 
-#define __CL_ENABLE_EXCEPTIONS
-#include <CL/cl.hpp>
+#include "pzcl_runtime.hpp"
 #include <cassert>
-#include <fstream>
 #include <iostream>
 #include <random>
 #include <sstream>
@@ -31,82 +29,22 @@ void cpuAdd(size_t num, std::vector<double>& dst, const std::vector<double>& src
     }
 }
 
-inline size_t getFileSize(std::ifstream& file)
-{
-    file.seekg(0, std::ios::end);
-    size_t ret = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    return ret;
-}
-
-inline void loadFile(std::ifstream& file, std::vector<char>& d, size_t size)
-{
-    d.resize(size);
-    file.read(reinterpret_cast<char*>(d.data()), size);
-}
-
-cl::Program createProgram(cl::Context& context, const std::vector<cl::Device>& devices, const std::string& filename)
-{
-    std::ifstream file;
-    file.open(filename, std::ios::in | std::ios::binary);
-
-    if (file.fail()) {
-        throw "can not open kernel file";
-    }
-
-    size_t            filesize = getFileSize(file);
-    std::vector<char> binary_data;
-    loadFile(file, binary_data, filesize);
-
-    cl::Program::Binaries binaries;
-    binaries.push_back(std::make_pair(&binary_data[0], filesize));
-
-    return cl::Program(context, devices, binaries, nullptr, nullptr);
-}
-
-cl::Program createProgram(cl::Context& context, const cl::Device& device, const std::string& filename)
-{
-    std::vector<cl::Device> devices { device };
-    return createProgram(context, devices, filename);
-}
-
 void pzcAdd(size_t num, std::vector<double>& dst, const std::vector<double>& src0, const std::vector<double>& src1)
 {
     try {
-        // Get Platform
-        std::vector<cl::Platform> platforms;
-        cl::Platform::get(&platforms);
-        const auto& Platform = platforms[0];
-
-        // Get devices
-        std::vector<cl::Device> devices;
-        Platform.getDevices(CL_DEVICE_TYPE_DEFAULT, &devices);
-
-        // Use first device.
-        const auto& device = devices[0];
-
-        // Create Context.
-        auto context = cl::Context(device);
-
-        // Create CommandQueue.
-        auto command_queue = cl::CommandQueue(context, device, 0);
+        // Create Context and CommandQueue on first device.
+        pzcl::Runtime runtime(0);
+        auto&         context       = runtime.context;
+        auto&         command_queue = runtime.queue;
 
         // Create Program.
-        // Load compiled binary file and create cl::Program object.
-        auto program = createProgram(context, device, "kernel/kernel.pz");
+        // Map compiled binary file and create cl::Program object.
+        auto program = runtime.loadProgram("kernel/kernel.pz");
 
         // Create Kernel.
         // Give kernel name without pzc_ prefix.
         auto kernel = cl::Kernel(program, "addWithLocal");
 
-        // Get stack size modify function.
-        typedef CL_API_ENTRY cl_int(CL_API_CALL * pfnPezyExtSetPerThreadStackSize)(cl_kernel kernel, size_t size);
-        const auto           clExtSetPerThreadStackSize = reinterpret_cast<pfnPezyExtSetPerThreadStackSize>(clGetExtensionFunctionAddress("pezy_set_per_thread_stack_size"));
-        if (clExtSetPerThreadStackSize == nullptr) {
-            throw "pezy_set_per_thread_stack_size not found";
-        }
-
         // Set stack size each thread.
         // Each thread's stack size is 2.5KB(SC2) / 2KB(SC) each thread by default.
         // This function will set stack size 1KB each thread.
@@ -117,7 +55,7 @@ void pzcAdd(size_t num, std::vector<double>& dst, const std::vector<double>& src
         // 16 - 8 =  8KB(SC)
         // as a user area.
         size_t stack_size_per_thread = 1024;
-        clExtSetPerThreadStackSize(kernel(), stack_size_per_thread);
+        pzcl::setPerThreadStackSize(kernel, stack_size_per_thread);
 
         // Create Buffers.
         auto device_src0 = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(double) * num);
@@ -138,26 +76,11 @@ void pzcAdd(size_t num, std::vector<double>& dst, const std::vector<double>& src
         kernel.setArg(1, device_dst);
         kernel.setArg(2, device_src0);
         kernel.setArg(3, device_src1);
+        kernel.setArg(4, stack_size_per_thread); // tiles fill what the stacks leave
 
         // Get workitem size.
-        // sc1-64: 8192  (1024 PEs * 8 threads)
-        // sc2   : 15782 (1984 PEs * 8 threads)
-        size_t global_work_size = 0;
-        {
-            std::string device_name;
-            device.getInfo(CL_DEVICE_NAME, &device_name);
-
-            size_t global_work_size_[3] = { 0 };
-            device.getInfo(CL_DEVICE_MAX_WORK_ITEM_SIZES, &global_work_size_);
-
-            global_work_size = global_work_size_[0];
-            if (device_name.find("PEZY-SC2") != std::string::npos) {
-                global_work_size = std::min(global_work_size, (size_t)15872);
-            }
-
-            std::cout << "Use device : " << device_name << std::endl;
-            std::cout << "workitem   : " << global_work_size << std::endl;
-        }
+        const size_t global_work_size = runtime.global_work_size;
+        runtime.showDeviceInfo();
 
         // Run device kernel.
         cl::Event event;
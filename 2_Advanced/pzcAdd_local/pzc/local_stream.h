@@ -0,0 +1,138 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Element-wise kernels streamed through the local memory of PEs
+ * @details   streamLocal splits N input and M output arrays into tiles,
+ *            gives the tiles to the PEs in turn and runs each tile through
+ *            the scratch pad of its PE. The tiles of a PE form a pipeline:
+ *            while tile k is computed, tile k + 1 is loaded and tile k - 1
+ *            stored, with one sync of the PE per tile. The tile is as large
+ *            as two buffers for every array allow in the scratch pad left
+ *            by the stacks.
+ */
+
+#ifndef LOCAL_STREAM_H
+#define LOCAL_STREAM_H
+
+#include <pzc_builtin.h>
+
+// Scratch pad of a PE. The stacks of its threads take the top of it,
+// the size given to pezy_set_per_thread_stack_size each.
+#if defined(__pezy_sc2__)
+constexpr size_t LOCAL_MEM_SIZE = 20 * 1024;
+#else
+constexpr size_t LOCAL_MEM_SIZE = 16 * 1024;
+#endif
+
+inline void sync_pe()
+{
+    __builtin_pz_sync_lv(1);
+}
+
+// Elements of a tile when N + M arrays of T are double buffered in local
+// memory left by threads of stack_size bytes. A multiple of the threads
+// of a PE, 0 if not even that fits.
+template <typename T, size_t N, size_t M>
+size_t tileSize(size_t stack_size)
+{
+    const size_t threads = get_maxtid();
+    const size_t stacks  = threads * stack_size;
+    if (stacks >= LOCAL_MEM_SIZE) {
+        return 0;
+    }
+
+    const size_t tile = (LOCAL_MEM_SIZE - stacks) / (2 * (N + M) * sizeof(T));
+    return tile / threads * threads;
+}
+
+// dst[m][i] for all M outputs of element i from src[n][i] of the N inputs:
+//   f(out, in) with T in[N], T out[M]
+// stack_size must be the one set by pezy_set_per_thread_stack_size for the
+// kernel. Without room for a tile, the arrays are streamed straight from
+// global memory.
+template <typename T, size_t N, size_t M, typename F>
+void streamLocal(size_t num, T* const (&dst)[M], const T* const (&src)[N], size_t stack_size, const F& f)
+{
+    const size_t pid    = get_pid();
+    const size_t tid    = get_tid();
+    const size_t maxpid = get_maxpid();
+    const size_t maxtid = get_maxtid();
+    const size_t tile   = tileSize<T, N, M>(stack_size);
+
+    T in[N];
+    T out[M];
+
+    if (tile == 0) {
+        for (size_t i = pid * maxtid + tid; i < num; i += maxpid * maxtid) {
+            for (size_t n = 0; n < N; ++n) {
+                in[n] = src[n][i];
+            }
+            chgthread();
+            f(out, in);
+            for (size_t m = 0; m < M; ++m) {
+                dst[m][i] = out[m];
+            }
+        }
+        return;
+    }
+
+    // Buffer b of input n and output m
+    T* const local  = (T*)get_local_mem_addr();
+    auto     input  = [&](size_t b, size_t n) { return local + (b * (N + M) + n) * tile; };
+    auto     output = [&](size_t b, size_t m) { return local + (b * (N + M) + N + m) * tile; };
+
+    // Tiles pid, pid + maxpid, ... of this PE. Its k-th tile uses buffers k % 2.
+    const size_t tiles = (num + tile - 1) / tile;
+    const size_t count = (tiles > pid) ? (tiles - pid + maxpid - 1) / maxpid : 0;
+    auto         first = [&](size_t k) { return (pid + k * maxpid) * tile; };
+    auto         size  = [&](size_t k) { return (num - first(k) < tile) ? num - first(k) : tile; };
+
+    for (size_t k = 0; k < count + 2; ++k) {
+        // load tile k
+        if (k < count) {
+            const size_t offset = first(k);
+            const size_t lim    = size(k);
+            for (size_t n = 0; n < N; ++n) {
+                T* const buf = input(k % 2, n);
+                for (size_t i = tid; i < lim; i += maxtid) {
+                    buf[i] = src[n][offset + i];
+                }
+            }
+            chgthread();
+        }
+
+        // compute tile k - 1
+        if (k >= 1 && k - 1 < count) {
+            const size_t b   = (k - 1) % 2;
+            const size_t lim = size(k - 1);
+            for (size_t i = tid; i < lim; i += maxtid) {
+                for (size_t n = 0; n < N; ++n) {
+                    in[n] = input(b, n)[i];
+                }
+                f(out, in);
+                for (size_t m = 0; m < M; ++m) {
+                    output(b, m)[i] = out[m];
+                }
+            }
+        }
+
+        // store tile k - 2
+        if (k >= 2) {
+            const size_t offset = first(k - 2);
+            const size_t lim    = size(k - 2);
+            for (size_t m = 0; m < M; ++m) {
+                const T* const buf = output(k % 2, m);
+                for (size_t i = tid; i < lim; i += maxtid) {
+                    dst[m][offset + i] = buf[i];
+                }
+            }
+        }
+
+        // Buffers k % 2 are complete for the next compute, (k - 1) % 2
+        // free for the next load.
+        sync_pe();
+    }
+}
+
+#endif
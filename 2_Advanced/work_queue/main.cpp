@@ -0,0 +1,266 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "pzcl_device_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+// Item costs in steps, 100 times apart. Expensive items come in regions of
+// REGION consecutive items, as areas of a mesh or an image that need more
+// work; one region in HEAVY_ONE_IN is expensive.
+constexpr uint32_t MIN_COST     = 10;
+constexpr uint32_t MAX_COST     = 1000;
+constexpr size_t   REGION       = 256;
+constexpr uint32_t HEAVY_ONE_IN = 8;
+
+std::mt19937 mt(0);
+
+void initVector(std::vector<double>& src)
+{
+    std::uniform_real_distribution<> rnd01(0.0, 1.0);
+    for (auto& s : src) {
+        s = rnd01(mt);
+    }
+}
+
+// Static striding hands the 8 threads of a PE 8 consecutive items per
+// round, so a PE gets a whole expensive region or none in each round, and
+// the PEs that drew the most of them set the kernel time.
+void initCosts(std::vector<uint32_t>& costs)
+{
+    std::uniform_int_distribution<uint32_t> rnd(0, HEAVY_ONE_IN - 1);
+    for (size_t first = 0; first < costs.size(); first += REGION) {
+        const uint32_t cost = rnd(mt) == 0 ? MAX_COST : MIN_COST;
+        std::fill(costs.begin() + first, costs.begin() + std::min(first + REGION, costs.size()), cost);
+    }
+}
+
+// Steps of each PE when kernel_name hands out the items on
+// global_work_size threads. The 8 threads of a PE share its pipeline, so
+// a PE takes the sum of the steps of its items.
+//   work_static: item i goes to thread i % global_work_size.
+//   work_dynamic, work_guided: the PE with the fewest steps so far claims
+//   the next chunk, sized as WorkQueue does. This greedy schedule leaves
+//   out the atomics and the chunks the other threads of a PE still hold.
+std::vector<uint64_t> peSteps(const std::string& kernel_name, const std::vector<uint32_t>& costs, size_t global_work_size, size_t chunk)
+{
+    const size_t          num = costs.size();
+    std::vector<uint64_t> steps(std::max<size_t>(global_work_size / 8, 1), 0);
+
+    if (kernel_name == "work_static") {
+        for (size_t i = 0; i < num; ++i) {
+            steps[(i % global_work_size) / 8] += costs[i];
+        }
+        return steps;
+    }
+
+    typedef std::pair<uint64_t, size_t> Load; // steps so far, PE
+    std::priority_queue<Load, std::vector<Load>, std::greater<Load>> pes;
+    for (size_t p = 0; p < steps.size(); ++p) {
+        pes.push(Load(0, p));
+    }
+
+    chunk = std::max<size_t>(chunk, 1);
+    for (size_t first = 0; first < num;) {
+        size_t size = chunk;
+        if (kernel_name == "work_guided") {
+            size = std::max(chunk, (num - first) / (2 * global_work_size));
+        }
+        const size_t last = std::min(first + size, num);
+
+        Load pe = pes.top();
+        pes.pop();
+        for (size_t i = first; i < last; ++i) {
+            pe.first += costs[i];
+        }
+        steps[pe.second] = pe.first;
+        pes.push(pe);
+
+        first = last;
+    }
+    return steps;
+}
+
+uint64_t busiest(const std::vector<uint64_t>& steps)
+{
+    return *std::max_element(steps.begin(), steps.end());
+}
+
+// Same steps as Work in kernel.pzc.
+void cpuWork(std::vector<double>& dst, const std::vector<double>& src, const std::vector<uint32_t>& costs)
+{
+    for (size_t i = 0; i < src.size(); ++i) {
+        double x = src[i];
+        for (uint32_t k = 0; k < costs[i]; ++k) {
+            x = x * 0.999 + 0.001;
+        }
+        dst[i] = x;
+    }
+}
+
+// Runs kernel_name ("work_static", "work_dynamic" or "work_guided") and
+// returns the kernel time in milliseconds.
+double pzcWork(const std::string& kernel_name, std::vector<double>& dst, const std::vector<double>& src, const std::vector<uint32_t>& costs, size_t chunk)
+{
+    try {
+        // Check out Context, CommandQueue (enable profiling) and Program
+        // of first device.
+        auto  device        = pzcl::DevicePool::instance().checkout(0, "kernel/kernel.pz", CL_QUEUE_PROFILING_ENABLE);
+        auto& command_queue = device->queue;
+
+        // Get Kernel.
+        auto& kernel = device->kernel(kernel_name);
+
+        const size_t num = src.size();
+
+        // Get Buffers.
+        auto  pooled_dst     = device->buffers->acquire(sizeof(double) * num);
+        auto  pooled_src     = device->buffers->acquire(sizeof(double) * num);
+        auto  pooled_costs   = device->buffers->acquire(sizeof(uint32_t) * num);
+        auto  pooled_counter = device->buffers->acquire(sizeof(size_t));
+        auto& device_dst     = pooled_dst.get();
+        auto& device_src     = pooled_src.get();
+        auto& device_costs   = pooled_costs.get();
+        auto& device_counter = pooled_counter.get();
+
+        // Send src and costs.
+        command_queue.enqueueWriteBuffer(device_src, true, 0, sizeof(double) * num, &src[0]);
+        command_queue.enqueueWriteBuffer(device_costs, true, 0, sizeof(uint32_t) * num, &costs[0]);
+
+        // Clear the counter. Every launch of the queue starts from 0.
+        const size_t zero = 0;
+        command_queue.enqueueWriteBuffer(device_counter, true, 0, sizeof(size_t), &zero);
+
+        // Set kernel args.
+        kernel.setArg(0, num);
+        kernel.setArg(1, device_dst);
+        kernel.setArg(2, device_src);
+        kernel.setArg(3, device_costs);
+        if (kernel_name != "work_static") {
+            kernel.setArg(4, device_counter);
+            kernel.setArg(5, chunk);
+        }
+
+        // Run device kernel.
+        cl::Event event;
+        command_queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(device->global_work_size), cl::NullRange, nullptr, &event);
+        event.wait();
+
+        // Get dst.
+        command_queue.enqueueReadBuffer(device_dst, true, 0, sizeof(double) * num, &dst[0]);
+
+        cl_ulong start, end;
+        event.getProfilingInfo(CL_PROFILING_COMMAND_START, &start);
+        event.getProfilingInfo(CL_PROFILING_COMMAND_END, &end);
+        return (end - start) / 1e6;
+    } catch (const cl::Error& e) {
+        std::stringstream msg;
+        msg << "CL Error : " << e.what() << " " << e.err();
+        throw std::runtime_error(msg.str());
+    }
+}
+
+bool verify(const std::vector<double>& actual, const std::vector<double>& expected)
+{
+    size_t error_count = 0;
+    for (size_t i = 0; i < actual.size(); ++i) {
+        if (std::fabs(actual[i] - expected[i]) > 1.e-12) {
+            if (error_count < 10) {
+                std::cerr << "# ERROR " << i << " " << actual[i] << " " << expected[i] << std::endl;
+            }
+            error_count++;
+        }
+    }
+    return error_count == 0;
+}
+}
+
+// Irregular work distributed statically and through a work queue.
+//
+//   workQueue [num [chunk]]
+//
+// num: number of items (default 1048576)
+// chunk: items per claim of the work queue (default 16)
+int main(int argc, char** argv)
+{
+    size_t num   = 1 << 20;
+    size_t chunk = 16; // a claim per 16 items keeps the atomics on the counter few
+
+    if (argc > 1) {
+        num = strtol(argv[1], nullptr, 10);
+    }
+    if (argc > 2) {
+        chunk = strtol(argv[2], nullptr, 10);
+    }
+    num = std::max<size_t>(num, 1);
+
+    std::cout << "num        : " << num << std::endl;
+    std::cout << "chunk      : " << chunk << std::endl;
+
+    std::vector<double>   src(num);
+    std::vector<uint32_t> costs(num);
+    initVector(src);
+    initCosts(costs);
+
+    std::vector<double> expected(num);
+    cpuWork(expected, src, costs);
+
+    bool ok = true;
+    try {
+        size_t global_work_size;
+        {
+            auto device      = pzcl::DevicePool::instance().checkout(0, "kernel/kernel.pz", CL_QUEUE_PROFILING_ENABLE);
+            global_work_size = device->global_work_size;
+        }
+
+        // The time static striding loses to imbalance, and so the most a
+        // work queue can gain.
+        const std::vector<uint64_t> static_steps = peSteps("work_static", costs, global_work_size, chunk);
+        const uint64_t              total        = std::accumulate(static_steps.begin(), static_steps.end(), uint64_t(0));
+        std::printf("static imbalance : %.2fx (busiest PE / mean PE)\n", double(busiest(static_steps)) * static_steps.size() / total);
+
+        // Measured time and speedup over work_static, then the steps of the
+        // busiest PE and the speedup expected from them.
+        double static_ms = 0.0;
+        for (const char* name : { "work_static", "work_dynamic", "work_guided" }) {
+            std::vector<double> dst(num, 0.0);
+
+            const double ms = pzcWork(name, dst, src, costs, chunk);
+            if (static_ms == 0.0) {
+                static_ms = ms;
+            }
+
+            const uint64_t steps = busiest(peSteps(name, costs, global_work_size, chunk));
+            const bool     pass  = verify(dst, expected);
+            std::printf("%-14s %10.4f ms %8.2fx %12llu steps %8.2fx %s\n", name, ms, static_ms / ms,
+                        static_cast<unsigned long long>(steps), double(busiest(static_steps)) / steps, pass ? "PASS" : "FAIL");
+            ok = ok && pass;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        ok = false;
+    }
+
+    if (ok) {
+        std::cout << "PASS" << std::endl;
+        return 0;
+    } else {
+        std::cout << "FAIL" << std::endl;
+        return 1;
+    }
+}
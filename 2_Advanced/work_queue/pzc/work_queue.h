@@ -0,0 +1,106 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Dynamic distribution of items to the threads of a kernel
+ * @details   Instead of the static `for (i = gid; i < num; i += GLOBAL_WORK_SIZE)`
+ *            loop, threads claim chunks of consecutive items from a counter
+ *            in global memory until all items are taken, so a thread that
+ *            got cheap items takes more of them. The host clears the
+ *            counter before each launch. Needs the atomic functions of
+ *            sc2 or later.
+ */
+
+#ifndef WORK_QUEUE_H
+#define WORK_QUEUE_H
+
+#include <pzc_builtin.h>
+
+class WorkQueue {
+public:
+    // counter: one size_t in global memory, 0 at launch
+    // num: number of items
+    // chunk: items per claim, at least 1. Larger chunks mean fewer atomics
+    //        but a longer tail.
+    WorkQueue(size_t* counter_, size_t num_, size_t chunk_)
+        : counter(counter_)
+        , num(num_)
+        , chunk(chunk_ > 0 ? chunk_ : 1)
+    {
+    }
+
+    // Claims the next chunk [*begin, *end) with one pz_atomic_add.
+    // Returns false when no item is left. The counter may end up past num,
+    // by at most one chunk per thread.
+    bool claim(size_t* begin, size_t* end)
+    {
+        const size_t first = pz_atomic_add(counter, chunk);
+        if (first >= num) {
+            return false;
+        }
+        *begin = first;
+        *end   = (num - first < chunk) ? num : first + chunk;
+        return true;
+    }
+
+    // Like claim, but the chunk shrinks with the items left: a share of
+    // 1 / (2 * threads) of them, never less than chunk. Large chunks at the
+    // start keep the atomics few, small ones at the end keep the tail
+    // short. Takes a pz_atomic_cmpxchg loop, since the size depends on the
+    // counter.
+    bool claimGuided(size_t* begin, size_t* end)
+    {
+        const size_t threads = get_maxtid() * get_maxpid();
+
+        size_t first = pz_atomic_load(counter);
+        while (first < num) {
+            const size_t left = num - first;
+            size_t       size = left / (2 * threads);
+            if (size < chunk) {
+                size = chunk;
+            }
+            if (size > left) {
+                size = left;
+            }
+
+            const size_t seen = pz_atomic_cmpxchg(counter, first, first + size);
+            if (seen == first) {
+                *begin = first;
+                *end   = first + size;
+                return true;
+            }
+            first = seen;
+        }
+        return false;
+    }
+
+    // Calls f(i) for every item claimed by this thread.
+    template <typename F>
+    void forEach(const F& f)
+    {
+        size_t begin, end;
+        while (claim(&begin, &end)) {
+            for (size_t i = begin; i < end; ++i) {
+                f(i);
+            }
+        }
+    }
+
+    template <typename F>
+    void forEachGuided(const F& f)
+    {
+        size_t begin, end;
+        while (claimGuided(&begin, &end)) {
+            for (size_t i = begin; i < end; ++i) {
+                f(i);
+            }
+        }
+    }
+
+private:
+    size_t*      counter;
+    const size_t num;
+    const size_t chunk;
+};
+
+#endif
@@ -0,0 +1,98 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "pzcl_device_pool.hpp"
+#include "suite.hpp"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+// Throughput of atomic operations by op, type, number of distinct target
+// addresses and their stride, as CSV on stdout.
+//
+//   atomicBench [iterations [max_addresses]]
+//
+// iterations: operations per thread (default 100)
+// max_addresses: largest number of targets (default: one per thread)
+int main(int argc, char** argv)
+{
+    size_t iterations    = 100;
+    size_t max_addresses = 0;
+
+    if (argc > 1) {
+        iterations = strtol(argv[1], nullptr, 10);
+    }
+    if (argc > 2) {
+        max_addresses = strtol(argv[2], nullptr, 10);
+    }
+
+    bool ok = true;
+    try {
+        // Check out Context, CommandQueue (enable profiling) and Program
+        // of first device.
+        auto  device        = pzcl::DevicePool::instance().checkout(0, "kernel/kernel.pz", CL_QUEUE_PROFILING_ENABLE);
+        auto& command_queue = device->queue;
+
+        // Get workitem size.
+        const size_t global_work_size = device->global_work_size;
+        if (max_addresses == 0) {
+            max_addresses = global_work_size;
+        }
+
+        const auto cases = benchCases(max_addresses);
+
+        // Targets, large enough for the widest case
+        size_t max_bytes = 0;
+        for (const auto& c : cases) {
+            max_bytes = std::max(max_bytes, targetBytes(c));
+        }
+        auto              pooled_targets = device->buffers->acquire(max_bytes);
+        auto&             targets        = pooled_targets.get();
+        std::vector<char> host(max_bytes);
+
+        printCsvHeader(std::cout);
+        for (const auto& c : cases) {
+            // Clear targets.
+            std::fill(host.begin(), host.end(), 0);
+            command_queue.enqueueWriteBuffer(targets, true, 0, max_bytes, &host[0]);
+
+            // Get Kernel and set kernel args.
+            auto& kernel = device->kernel(kernelName(c));
+            kernel.setArg(0, targets);
+            kernel.setArg(1, c.addresses);
+            kernel.setArg(2, c.stride);
+            kernel.setArg(3, iterations);
+
+            // Run device kernel.
+            cl::Event event;
+            command_queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_work_size), cl::NullRange, nullptr, &event);
+            event.wait();
+
+            cl_ulong start, end;
+            event.getProfilingInfo(CL_PROFILING_COMMAND_START, &start);
+            event.getProfilingInfo(CL_PROFILING_COMMAND_END, &end);
+
+            // Check counting ops.
+            const size_t ops = global_work_size * iterations;
+            command_queue.enqueueReadBuffer(targets, true, 0, max_bytes, &host[0]);
+            if (!verifyTargets(c, &host[0], ops)) {
+                std::cerr << "# ERROR " << kernelName(c) << " addresses " << c.addresses << " stride " << c.stride << std::endl;
+                ok = false;
+            }
+
+            printCsvRow(std::cout, c, ops, (end - start) / 1e9);
+        }
+    } catch (const cl::Error& e) {
+        std::cerr << "CL Error : " << e.what() << " " << e.err() << std::endl;
+        ok = false;
+    }
+
+    // The CSV goes to stdout, so the result goes to stderr.
+    std::cerr << (ok ? "PASS" : "FAIL") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "suite.hpp"
+#include <stdexcept>
+#include <utility>
+
+namespace {
+size_t typeSize(const std::string& type)
+{
+    if (type == "int" || type == "float") {
+        return 4;
+    } else if (type == "long" || type == "double") {
+        return 8;
+    }
+    throw std::invalid_argument("unknown type: " + type);
+}
+
+template <typename T>
+double sumTargets(const BenchCase& c, const void* targets)
+{
+    const char* p   = static_cast<const char*>(targets);
+    double      sum = 0.0;
+    for (size_t i = 0; i < c.addresses; ++i) {
+        sum += *reinterpret_cast<const T*>(p + i * c.stride);
+    }
+    return sum;
+}
+}
+
+std::vector<BenchCase> benchCases(size_t max_addresses)
+{
+    // Ops and the types they are built for, as in pzc/kernel.pzc
+    const std::vector<std::pair<std::string, std::vector<std::string>>> ops = {
+        { "add", { "int", "long", "float", "double" } },
+        { "add_flush", { "int", "double" } },
+        { "xchg", { "int", "long" } },
+        { "cmpxchg", { "int", "long" } },
+        { "min", { "int", "long" } },
+        { "max", { "int", "long" } },
+    };
+
+    std::vector<BenchCase> cases;
+    for (const auto& op : ops) {
+        for (const auto& type : op.second) {
+            for (size_t stride : { typeSize(type), PADDED_STRIDE }) {
+                for (size_t addresses = 1; addresses <= max_addresses; addresses *= 2) {
+                    cases.push_back({ op.first, type, addresses, stride });
+                }
+            }
+        }
+    }
+    return cases;
+}
+
+std::string kernelName(const BenchCase& c)
+{
+    return "atomic_" + c.op + "_" + c.type;
+}
+
+size_t targetBytes(const BenchCase& c)
+{
+    return c.stride * (c.addresses - 1) + typeSize(c.type);
+}
+
+bool verifyTargets(const BenchCase& c, const void* targets, size_t ops)
+{
+    if (c.op != "add" && c.op != "add_flush" && c.op != "cmpxchg") {
+        return true;
+    }
+
+    double sum = 0.0;
+    if (c.type == "int") {
+        sum = sumTargets<int>(c, targets);
+    } else if (c.type == "long") {
+        sum = sumTargets<long>(c, targets);
+    } else if (c.type == "float") {
+        sum = sumTargets<float>(c, targets);
+    } else {
+        sum = sumTargets<double>(c, targets);
+    }
+    return sum == static_cast<double>(ops);
+}
+
+void printCsvHeader(std::ostream& os)
+{
+    os << "op,type,addresses,stride,ops,seconds,ops_per_second" << std::endl;
+}
+
+void printCsvRow(std::ostream& os, const BenchCase& c, size_t ops, double seconds)
+{
+    os << c.op << "," << c.type << "," << c.addresses << "," << c.stride << "," << ops << "," << seconds << "," << ops / seconds << std::endl;
+}
@@ -0,0 +1,45 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Cases and CSV output of the atomic benchmark
+ * @details   Shared by the device program and the emulator build, so both
+ *            run the same sweep and print the same columns.
+ */
+
+#ifndef SUITE_HPP
+#define SUITE_HPP
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Bytes between padded targets, more than a cache line.
+constexpr size_t PADDED_STRIDE = 128;
+
+struct BenchCase {
+    std::string op;        // add, add_flush, xchg, cmpxchg, min or max
+    std::string type;      // int, long, float or double
+    size_t      addresses; // distinct targets
+    size_t      stride;    // bytes between targets
+};
+
+// Every op with each type it is built for, addresses 1, 2, 4, ... up to
+// max_addresses, targets packed (stride of the type) and padded.
+std::vector<BenchCase> benchCases(size_t max_addresses);
+
+// Kernel of c without pzc_ prefix.
+std::string kernelName(const BenchCase& c);
+
+// Bytes of the targets of c.
+size_t targetBytes(const BenchCase& c);
+
+// For ops that add 1 per call, checks that the targets of c sum to ops.
+// Other ops always pass.
+bool verifyTargets(const BenchCase& c, const void* targets, size_t ops);
+
+void printCsvHeader(std::ostream& os);
+void printCsvRow(std::ostream& os, const BenchCase& c, size_t ops, double seconds);
+
+#endif
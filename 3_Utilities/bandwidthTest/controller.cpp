@@ -12,56 +12,21 @@
 #include <sstream>
 #include <stdexcept>
 
-typedef CL_API_ENTRY cl_int(CL_API_CALL* PezyExtMemLock)(cl_context, void*, size_t);
-typedef CL_API_ENTRY cl_int(CL_API_CALL* PezyExtMemUnLock)(cl_context, void*, size_t);
-
 namespace {
 constexpr size_t DEFAULT_SIZE = (32 * (1 << 20));
 
 std::mt19937 mt(0);
 
-template <typename T>
-void fill(std::vector<T>& vec)
+// Host arrays, pinned or pageable depending on their allocator.
+typedef pzcl::PinnedVector<size_t> HostVector;
+
+void fill(HostVector& vec)
 {
     for (auto& v : vec) {
         v = mt();
     }
 }
 
-PezyExtMemLock   clExtMemLock   = nullptr;
-PezyExtMemUnLock clExtMemUnLock = nullptr;
-
-void lockFunc(cl::Context& context, void* ptr, size_t size)
-{
-    cl_int ret = clExtMemLock(context(), ptr, size);
-    if (ret != CL_SUCCESS) {
-        throw cl::Error(-2, "clExtMemLock: Can not lock mem");
-    }
-}
-
-void unLockFunc(cl::Context& context, void* ptr, size_t size)
-{
-    cl_int ret = clExtMemUnLock(context(), ptr, size);
-    if (ret != CL_SUCCESS) {
-        throw cl::Error(-3, "clExtMemUnLock: Can not unlock mem");
-    }
-}
-
-void checkAndLock(pezy::MEMMODE mem_mode, cl::Context& context, void* ptr, size_t size)
-{
-    // Check pinned or pageable
-    if (mem_mode == pezy::PINNED) {
-        lockFunc(context, ptr, size);
-    }
-}
-
-void checkAndUnLock(pezy::MEMMODE mem_mode, cl::Context& context, void* ptr, size_t size)
-{
-    if (mem_mode == pezy::PINNED) {
-        unLockFunc(context, ptr, size);
-    }
-}
-
 void dispTrans()
 {
     std::cout << "\tTransfer Size(byte)\t\tBandwidth(MB/s)" << std::endl;
@@ -77,7 +42,7 @@ void dispMemMode(pezy::MEMMODE mem_mode)
     }
 }
 
-bool verify(const std::vector<size_t>& actual, std::vector<size_t>& expected)
+bool verify(const HostVector& actual, const HostVector& expected)
 {
     assert(actual.size() == expected.size());
     size_t num = actual.size();
@@ -108,36 +73,20 @@ Controller::Controller(size_t id_)
 void Controller::init()
 {
     try {
-        // Get Platform
-        std::vector<cl::Platform> platforms;
-        cl::Platform::get(&platforms);
-        const auto& Platform = platforms[0];
-
-        // Get devices
-        std::vector<cl::Device> devices;
-        Platform.getDevices(CL_DEVICE_TYPE_DEFAULT, &devices);
-
-        if (device_id > devices.size()) {
-            std::cerr << "Invalid device id. Use first device " << std::endl;
-            device_id = 0;
-        }
-
-        const auto& device = devices[device_id];
-        context            = cl::Context(device);
+        pzcl::Runtime runtime(device_id, CL_QUEUE_PROFILING_ENABLE);
 
-        cl_command_queue_properties prop = 0;
-        prop                             = CL_QUEUE_PROFILING_ENABLE;
-        queue                            = cl::CommandQueue(context, device, prop);
+        device_id = runtime.device_id;
+        context   = runtime.context;
+        queue     = runtime.queue;
+        buffers.reset(new pzcl::BufferPool(context));
 
-        // get memlock function
-        clExtMemLock = (PezyExtMemLock)clGetExtensionFunctionAddress("pezy_mem_lock");
-        if (clExtMemLock == nullptr) {
-            throw cl::Error(-1, "clGetExtensitonFunctionAddress: Can not get pezy_mem_lock");
-        }
+        // Host memory is locked once per pool block, not per measurement.
+        pinned.reset(new pzcl::PinnedPool(context));
 
-        clExtMemUnLock = (PezyExtMemUnLock)clGetExtensionFunctionAddress("pezy_mem_unlock");
-        if (clExtMemUnLock == nullptr) {
-            throw cl::Error(-1, "clGetExtensitonFunctionAddress: Can not get pezy_mem_unlock");
+        // The pool falls back to mlock without pezy_mem_lock, which would
+        // measure other transfers than PINNED says.
+        if (pinned->lockMode() != pzcl::PinnedPool::PEZY_MEM_LOCK) {
+            throw cl::Error(-1, "clGetExtensionFunctionAddress: Can not get pezy_mem_lock");
         }
     } catch (const cl::Error& e) {
         std::stringstream msg;
@@ -209,6 +158,12 @@ void Controller::test(MEMMODE mem_mode, MEASURE measure, size_t range_start, siz
 {
     bool is_true = true;
 
+    // Pinned arrays come from the pool, pageable ones from the heap.
+    pzcl::PinnedAllocator<size_t> alloc;
+    if (mem_mode == PINNED) {
+        alloc = pzcl::PinnedAllocator<size_t>(pinned.get());
+    }
+
     if (measure == HtoD || measure == ALL) {
         std::cout << "\n";
         std::cout << " Host to Device Bandwidth, " << std::endl;
@@ -224,23 +179,21 @@ void Controller::test(MEMMODE mem_mode, MEASURE measure, size_t range_start, siz
         dispTrans();
 
         for (size_t i = range_start; i <= range_end; i += range_inc) {
-            size_t              size = (i + (sizeof(size_t) - 1)) & ~(sizeof(size_t) - 1);
-            std::vector<size_t> host_src(size / sizeof(size_t));
+            size_t     size = (i + (sizeof(size_t) - 1)) & ~(sizeof(size_t) - 1);
+            HostVector host_src(size / sizeof(size_t), 0, alloc);
             fill(host_src);
 
             void* host_src_ptr = &host_src[0];
-            checkAndLock(mem_mode, context, host_src_ptr, size);
 
-            auto buf = cl::Buffer(context, CL_MEM_READ_WRITE, size);
+            auto  pooled = buffers->acquire(size);
+            auto& buf    = pooled.get();
 
             testOneShot(host_src_ptr, buf, size, trans);
 
             // check
-            std::vector<size_t> host_dst(size / sizeof(size_t));
+            HostVector host_dst(size / sizeof(size_t), 0, alloc);
             queue.enqueueReadBuffer(buf, true, 0, size, &host_dst[0]);
 
-            checkAndUnLock(mem_mode, context, host_src_ptr, size);
-
             if (!verify(host_dst, host_src)) {
                 std::cerr << " " << size << " Write Test failed " << std::endl;
                 is_true = false;
@@ -262,26 +215,22 @@ void Controller::test(MEMMODE mem_mode, MEASURE measure, size_t range_start, siz
 
         dispTrans();
         for (size_t i = range_start; i <= range_end; i += range_inc) {
-            size_t              size = (i + (sizeof(size_t) - 1)) & ~(sizeof(size_t) - 1);
-            std::vector<size_t> host_src(size / sizeof(size_t));
+            size_t     size = (i + (sizeof(size_t) - 1)) & ~(sizeof(size_t) - 1);
+            HostVector host_src(size / sizeof(size_t), 0, alloc);
             fill(host_src);
 
             void* host_src_ptr = &host_src[0];
-            checkAndLock(mem_mode, context, host_src_ptr, size);
 
-            auto buf = cl::Buffer(context, CL_MEM_READ_WRITE, size);
+            auto  pooled = buffers->acquire(size);
+            auto& buf    = pooled.get();
             queue.enqueueWriteBuffer(buf, true, 0, size, host_src_ptr);
 
-            std::vector<size_t> host_dst(size / sizeof(size_t));
-            void*               host_dst_ptr = &host_dst[0];
-            checkAndLock(mem_mode, context, host_dst_ptr, size);
+            HostVector host_dst(size / sizeof(size_t), 0, alloc);
+            void*      host_dst_ptr = &host_dst[0];
 
             testOneShot(host_dst_ptr, buf, size, trans);
 
             // check
-            checkAndUnLock(mem_mode, context, host_src_ptr, size);
-            checkAndUnLock(mem_mode, context, host_dst_ptr, size);
-
             if (!verify(host_dst, host_src)) {
                 std::cerr << " " << size << " Read Test failed " << std::endl;
                 is_true = false;
@@ -289,6 +238,9 @@ void Controller::test(MEMMODE mem_mode, MEASURE measure, size_t range_start, siz
         }
     }
 
+    std::cout << "\n";
+    std::cout << " Device buffer pool: " << buffers->hits() << " hits, " << buffers->misses() << " misses" << std::endl;
+
     // verify
     std::cout << "\n";
     std::cout << "RESULT = ";
@@ -7,9 +7,11 @@
 #ifndef CONTROLLER_HPP
 #define CONTROLLER_HPP
 
-#define __CL_ENABLE_EXCEPTIONS
-#include <CL/cl.hpp>
+#include "pzcl_buffer_pool.hpp"
+#include "pzcl_pinned_pool.hpp"
+#include "pzcl_runtime.hpp"
 #include <functional>
+#include <memory>
 
 namespace pezy {
 enum MEMMODE {
@@ -49,6 +51,11 @@ private:
     cl::Context      context;
     cl::CommandQueue queue;
 
+    // Device buffers and pinned host arrays reused across the sizes of a
+    // range test.
+    std::unique_ptr<pzcl::BufferPool> buffers;
+    std::unique_ptr<pzcl::PinnedPool> pinned;
+
     void init();
     void showDeviceInfo() const;
 
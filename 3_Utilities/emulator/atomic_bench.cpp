@@ -0,0 +1,98 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "emulator.hpp"
+#include "kernels/kernels.hpp"
+#include "suite.hpp"
+
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// 3_Utilities/atomicBench on emulated threads, same cases and CSV.
+// The atomics map to host atomic instructions, so the numbers show the
+// contention of the host, not of a PEZY device.
+//
+//   atomicBench [iterations [max_addresses]]
+
+namespace {
+typedef std::function<void(void*, size_t, size_t, size_t)> Kernel;
+
+template <typename T>
+Kernel wrap(void (*kernel)(T*, size_t, size_t, size_t))
+{
+    return [kernel](void* targets, size_t addresses, size_t stride, size_t iterations) {
+        kernel(static_cast<T*>(targets), addresses, stride, iterations);
+    };
+}
+
+const std::map<std::string, Kernel> kernels = {
+    { "atomic_add_int", wrap(atomicBench::pzc_atomic_add_int) },
+    { "atomic_add_long", wrap(atomicBench::pzc_atomic_add_long) },
+    { "atomic_add_float", wrap(atomicBench::pzc_atomic_add_float) },
+    { "atomic_add_double", wrap(atomicBench::pzc_atomic_add_double) },
+    { "atomic_add_flush_int", wrap(atomicBench::pzc_atomic_add_flush_int) },
+    { "atomic_add_flush_double", wrap(atomicBench::pzc_atomic_add_flush_double) },
+    { "atomic_xchg_int", wrap(atomicBench::pzc_atomic_xchg_int) },
+    { "atomic_xchg_long", wrap(atomicBench::pzc_atomic_xchg_long) },
+    { "atomic_cmpxchg_int", wrap(atomicBench::pzc_atomic_cmpxchg_int) },
+    { "atomic_cmpxchg_long", wrap(atomicBench::pzc_atomic_cmpxchg_long) },
+    { "atomic_min_int", wrap(atomicBench::pzc_atomic_min_int) },
+    { "atomic_min_long", wrap(atomicBench::pzc_atomic_min_long) },
+    { "atomic_max_int", wrap(atomicBench::pzc_atomic_max_int) },
+    { "atomic_max_long", wrap(atomicBench::pzc_atomic_max_long) },
+};
+}
+
+int main(int argc, char** argv)
+{
+    size_t iterations    = 100;
+    size_t max_addresses = 0;
+
+    if (argc > 1) {
+        iterations = strtol(argv[1], nullptr, 10);
+    }
+    if (argc > 2) {
+        max_addresses = strtol(argv[2], nullptr, 10);
+    }
+
+    const pzcemu::Config config = pzcemu::defaultConfig();
+    if (max_addresses == 0) {
+        max_addresses = config.global_work_size;
+    }
+
+    const auto cases = benchCases(max_addresses);
+
+    // Targets as longs, so every type is aligned
+    size_t max_bytes = 0;
+    for (const auto& c : cases) {
+        max_bytes = std::max(max_bytes, targetBytes(c));
+    }
+    std::vector<long> targets((max_bytes + sizeof(long) - 1) / sizeof(long));
+
+    bool ok = true;
+    printCsvHeader(std::cout);
+    for (const auto& c : cases) {
+        std::fill(targets.begin(), targets.end(), 0);
+
+        const auto& kernel = kernels.at(kernelName(c));
+        const auto  stats  = pzcemu::launch(config, [&] { kernel(&targets[0], c.addresses, c.stride, iterations); });
+
+        const size_t ops = config.global_work_size * iterations;
+        if (!verifyTargets(c, &targets[0], ops)) {
+            std::cerr << "# ERROR " << kernelName(c) << " addresses " << c.addresses << " stride " << c.stride << std::endl;
+            ok = false;
+        }
+        printCsvRow(std::cout, c, ops, stats.elapsed);
+    }
+
+    // The CSV goes to stdout, so the result goes to stderr.
+    std::cerr << (ok ? "PASS" : "FAIL") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,236 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "barrier.hpp"
+#include "futex.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace pzcemu {
+namespace detail {
+    namespace {
+        constexpr size_t THREAD_IN_PE = 8;
+        constexpr size_t FAN_OUT      = 4; // PEs in a village, villages in a city
+
+        // Pseudo scope of a thread that has returned from the kernel.
+        constexpr int FINISHED = SCOPE_CHIP + 1;
+
+        inline void cpuRelax()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield");
+#endif
+        }
+
+        class SpinLock {
+        public:
+            SpinLock()
+                : locked(false)
+            {
+            }
+
+            void lock()
+            {
+                size_t spin = 0;
+                while (locked.exchange(true, std::memory_order_acquire)) {
+                    while (locked.load(std::memory_order_relaxed)) {
+                        // The holder may be descheduled when threads outnumber cores.
+                        if (++spin % 256 == 0) {
+                            std::this_thread::yield();
+                        } else {
+                            cpuRelax();
+                        }
+                    }
+                }
+            }
+
+            void unlock()
+            {
+                locked.store(false, std::memory_order_release);
+            }
+
+        private:
+            std::atomic<bool> locked;
+        };
+
+        inline size_t ceilDiv(size_t a, size_t b)
+        {
+            return (a + b - 1) / b;
+        }
+    }
+
+    struct HierarchicalBarrier::Node {
+        SpinLock              lock;
+        std::atomic<uint32_t> generation;
+        std::atomic<uint32_t> sleepers;
+        int                   scope;
+        uint32_t              size;
+        // count[s - 1]: children that reached a sync of scope >= s (or returned).
+        uint32_t count[FINISHED];
+        Node*    parent;
+        Node*    children; // first child, nullptr for a PE
+        uint32_t child_nodes;
+
+        Node()
+            : generation(0)
+            , sleepers(0)
+            , scope(SCOPE_PE)
+            , size(0)
+            , count()
+            , parent(nullptr)
+            , children(nullptr)
+            , child_nodes(0)
+        {
+        }
+    };
+
+    HierarchicalBarrier::HierarchicalBarrier(size_t pe_count_, size_t spin_count_)
+        : pe_count(pe_count_)
+        , village_count(ceilDiv(pe_count_, FAN_OUT))
+        , city_count(ceilDiv(village_count, FAN_OUT))
+        , spin_count(spin_count_)
+    {
+        Node* pes      = nullptr;
+        Node* villages = nullptr;
+        Node* cities   = nullptr;
+        Node* chip     = nullptr;
+
+        nodes.reset(new Node[pe_count + village_count + city_count + 1]);
+        pes      = &nodes[0];
+        villages = pes + pe_count;
+        cities   = villages + village_count;
+        chip     = cities + city_count;
+
+        for (size_t i = 0; i < pe_count; ++i) {
+            pes[i].scope  = SCOPE_PE;
+            pes[i].size   = THREAD_IN_PE;
+            pes[i].parent = &villages[i / FAN_OUT];
+        }
+        for (size_t i = 0; i < village_count; ++i) {
+            villages[i].scope       = SCOPE_VILLAGE;
+            villages[i].size        = std::min(FAN_OUT, pe_count - i * FAN_OUT);
+            villages[i].parent      = &cities[i / FAN_OUT];
+            villages[i].children    = &pes[i * FAN_OUT];
+            villages[i].child_nodes = villages[i].size;
+        }
+        for (size_t i = 0; i < city_count; ++i) {
+            cities[i].scope       = SCOPE_CITY;
+            cities[i].size        = std::min(FAN_OUT, village_count - i * FAN_OUT);
+            cities[i].parent      = chip;
+            cities[i].children    = &villages[i * FAN_OUT];
+            cities[i].child_nodes = cities[i].size;
+        }
+        chip->scope       = SCOPE_CHIP;
+        chip->size        = city_count;
+        chip->children    = cities;
+        chip->child_nodes = city_count;
+    }
+
+    HierarchicalBarrier::~HierarchicalBarrier()
+    {
+    }
+
+    HierarchicalBarrier::Ticket HierarchicalBarrier::arrive(size_t pid, int scope)
+    {
+        scope = std::max(static_cast<int>(SCOPE_PE), std::min(scope, static_cast<int>(SCOPE_CHIP)));
+
+        Node* root = &nodes[pid];
+        while (root->scope < scope) {
+            root = root->parent;
+        }
+
+        // Read the generation before arriving, our arrival may release it.
+        Ticket ticket = { root, root->generation.load(std::memory_order_acquire), scope };
+        propagate(&nodes[pid], SCOPE_PE, scope);
+        return ticket;
+    }
+
+    void HierarchicalBarrier::finish(size_t pid)
+    {
+        propagate(&nodes[pid], SCOPE_PE, FINISHED);
+    }
+
+    // A child of node reached scopes [from, to].
+    void HierarchicalBarrier::propagate(Node* node, int from, int to)
+    {
+        while (node != nullptr && from <= to) {
+            node->lock.lock();
+
+            // count[] is non-increasing in scope, so the scopes this node
+            // has just completed are [from, complete].
+            int complete = from - 1;
+            for (int s = from; s <= to; ++s) {
+                if (++node->count[s - 1] == node->size && complete == s - 1) {
+                    complete = s;
+                }
+            }
+
+            if (complete >= node->scope) {
+                release(node);
+            }
+
+            node->lock.unlock();
+
+            from = node->scope + 1;
+            to   = complete;
+            node = node->parent;
+        }
+    }
+
+    // Every thread below node reached a sync of node->scope or wider.
+    // Must be called with node->lock held.
+    void HierarchicalBarrier::release(Node* node)
+    {
+        reset(node, node->scope);
+
+        node->generation.fetch_add(1, std::memory_order_seq_cst);
+        if (node->sleepers.load(std::memory_order_seq_cst) > 0) {
+            futexWakeAll(&node->generation);
+        }
+    }
+
+    // Threads waiting at exactly scope leave. What remains below node are
+    // the threads at wider scopes, which are counted in count[scope].
+    void HierarchicalBarrier::reset(Node* node, int scope)
+    {
+        for (int s = SCOPE_PE; s <= scope; ++s) {
+            node->count[s - 1] = node->count[scope];
+        }
+        for (uint32_t i = 0; i < node->child_nodes; ++i) {
+            Node* child = &node->children[i];
+            child->lock.lock();
+            reset(child, scope);
+            child->lock.unlock();
+        }
+    }
+
+    bool HierarchicalBarrier::released(const Ticket& ticket)
+    {
+        return ticket.node->generation.load(std::memory_order_acquire) != ticket.generation;
+    }
+
+    void HierarchicalBarrier::wait(const Ticket& ticket) const
+    {
+        for (size_t i = 0; i < spin_count; ++i) {
+            if (released(ticket)) {
+                return;
+            }
+            cpuRelax();
+        }
+
+        Node* node = ticket.node;
+        node->sleepers.fetch_add(1, std::memory_order_seq_cst);
+        while (node->generation.load(std::memory_order_seq_cst) == ticket.generation) {
+            futexWait(&node->generation, ticket.generation);
+        }
+        node->sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+}
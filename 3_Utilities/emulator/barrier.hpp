@@ -0,0 +1,64 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Hierarchical barrier for the emulated PE/village/city/chip tree
+ * @details   A sync of some scope waits until every thread of the scope has
+ *            reached a sync of the same or a wider scope, or has returned
+ *            from the kernel. Arrivals are combined up the tree with a
+ *            spin lock per node; the last arrival of a scope releases it
+ *            by bumping the generation of its node. Waiters spin for a
+ *            while and then sleep on the generation with futex.
+ */
+
+#ifndef PZCEMU_BARRIER_HPP
+#define PZCEMU_BARRIER_HPP
+
+#include <pzc_builtin.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace pzcemu {
+namespace detail {
+    class HierarchicalBarrier {
+        struct Node;
+
+    public:
+        // Sync point of one thread. Released once the generation of node moves on.
+        struct Ticket {
+            Node*    node;
+            uint32_t generation;
+            int      scope;
+        };
+
+        HierarchicalBarrier(size_t pe_count, size_t spin_count);
+        ~HierarchicalBarrier();
+
+        // Registers the arrival of a thread of PE pid at a sync of scope.
+        Ticket arrive(size_t pid, int scope);
+
+        // Marks a thread of PE pid as returned from the kernel.
+        void finish(size_t pid);
+
+        static bool released(const Ticket& ticket);
+
+        // Spins, then sleeps until the ticket is released.
+        void wait(const Ticket& ticket) const;
+
+    private:
+        void propagate(Node* node, int from, int to);
+        void release(Node* node);
+        void reset(Node* node, int scope);
+
+        std::unique_ptr<Node[]> nodes;
+        size_t                  pe_count;
+        size_t                  village_count;
+        size_t                  city_count;
+        size_t                  spin_count;
+    };
+}
+}
+
+#endif
@@ -0,0 +1,286 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "emulator.hpp"
+#include "barrier.hpp"
+#include "fiber.hpp"
+#include <pzc_builtin.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace pzcemu {
+namespace {
+    constexpr size_t THREAD_IN_PE      = 8;
+    constexpr size_t SCOPES            = SCOPE_CHIP;
+    constexpr size_t FIBER_STACK_SIZE  = 64 * 1024;
+    constexpr size_t SCRATCH_PAD_SIZE  = 20 * 1024; // per PE (SC2)
+    constexpr size_t DEFAULT_STACK     = 2560;      // per thread (SC2)
+    constexpr size_t DEFAULT_WORK_SIZE = 1024;
+    constexpr size_t DEFAULT_PE_GROUP  = 16; // PEs in a city
+
+    struct ThreadStats {
+        double wait[SCOPES];
+        size_t syncs[SCOPES];
+    };
+
+    inline bool isPowerOfTwo(size_t n)
+    {
+        return n != 0 && (n & (n - 1)) == 0;
+    }
+}
+
+namespace detail {
+    thread_local ThreadContext* current = nullptr;
+
+    class Worker;
+
+    // An emulated hardware thread, run as a fiber on a worker.
+    struct HardwareThread {
+        enum State {
+            RUNNABLE,
+            WAITING,
+            DONE,
+        };
+
+        ThreadContext               ctx;
+        Worker*                     worker;
+        std::unique_ptr<Fiber>      fiber;
+        State                       state;
+        HierarchicalBarrier::Ticket ticket;
+        ThreadStats                 stats;
+    };
+
+    struct Engine {
+        Engine(size_t pe_count, size_t spin_count, const std::function<void()>& kernel_)
+            : barrier(pe_count, spin_count)
+            , kernel(kernel_)
+        {
+        }
+
+        HierarchicalBarrier          barrier;
+        const std::function<void()>& kernel;
+    };
+
+    // OS thread running the hardware threads of consecutive PEs.
+    // chgthread() and syncs switch to the next runnable fiber round robin,
+    // like the hardware switches threads of a PE on a stall.
+    class Worker {
+    public:
+        Worker(Engine& engine_, std::vector<ThreadContext>::iterator first, size_t count)
+            : engine(engine_)
+            , stacks(count, FIBER_STACK_SIZE)
+            , threads(count)
+            , running(0)
+        {
+            for (size_t i = 0; i < count; ++i) {
+                auto& t  = threads[i];
+                t.ctx    = first[i];
+                t.worker = this;
+                t.fiber.reset(new Fiber(fiberMain, &t, stacks.stack(i), stacks.stackSize()));
+                t.state = HardwareThread::RUNNABLE;
+                t.stats = ThreadStats();
+            }
+        }
+
+        // Body of the OS thread. Returns when every fiber has returned from the kernel.
+        void run()
+        {
+            running = 0;
+            current = &threads[running].ctx;
+            Fiber::switchTo(scheduler, *threads[running].fiber);
+            current = nullptr;
+        }
+
+        void yield()
+        {
+            const size_t n = threads.size();
+            for (;;) {
+                const HierarchicalBarrier::Ticket* blocking = nullptr;
+
+                for (size_t k = 1; k <= n; ++k) {
+                    size_t i = (running + k) % n;
+                    auto&  t = threads[i];
+                    if (t.state == HardwareThread::WAITING && HierarchicalBarrier::released(t.ticket)) {
+                        t.state = HardwareThread::RUNNABLE;
+                    }
+                    if (t.state == HardwareThread::RUNNABLE) {
+                        resume(i);
+                        return;
+                    }
+                    if (t.state == HardwareThread::WAITING && (blocking == nullptr || t.ticket.scope < blocking->scope)) {
+                        blocking = &t.ticket;
+                    }
+                }
+
+                if (blocking == nullptr) {
+                    // All done. The fiber is never resumed.
+                    Fiber::switchTo(*threads[running].fiber, scheduler);
+                }
+
+                // Nothing to run here. The narrowest sync is likely released first.
+                engine.barrier.wait(*blocking);
+            }
+        }
+
+        void sync(int level)
+        {
+            auto& t     = threads[running];
+            auto  start = std::chrono::steady_clock::now();
+            t.ticket    = engine.barrier.arrive(t.ctx.pid, level);
+            t.state     = HardwareThread::WAITING;
+            yield();
+            auto end = std::chrono::steady_clock::now();
+
+            // Includes the time the other fibers of this worker ran meanwhile.
+            size_t s = scopeIndex(t.ticket.scope);
+            t.stats.wait[s] += std::chrono::duration<double>(end - start).count();
+            t.stats.syncs[s]++;
+        }
+
+        void addStats(Stats& stats) const
+        {
+            for (const auto& t : threads) {
+                for (size_t s = 0; s < SCOPES; ++s) {
+                    stats.wait[s] += t.stats.wait[s];
+                    stats.syncs[s] += t.stats.syncs[s];
+                }
+            }
+        }
+
+    private:
+        static void fiberMain(void* arg)
+        {
+            auto*   t      = static_cast<HardwareThread*>(arg);
+            Worker* worker = t->worker;
+
+            current = &t->ctx;
+            worker->engine.kernel();
+            worker->engine.barrier.finish(t->ctx.pid);
+            t->state = HardwareThread::DONE;
+            worker->yield();
+        }
+
+        void resume(size_t i)
+        {
+            if (i != running) {
+                size_t prev = running;
+                running     = i;
+                Fiber::switchTo(*threads[prev].fiber, *threads[i].fiber);
+            }
+            // Back on the fiber that called yield().
+            current = &threads[running].ctx;
+        }
+
+        Engine&                     engine;
+        Fiber                       scheduler;
+        FiberStacks                 stacks; // one mapping for all fibers
+        std::vector<HardwareThread> threads;
+        size_t                      running;
+    };
+
+    thread_local Worker* this_worker = nullptr;
+
+    void sync(int level)
+    {
+        this_worker->sync(level);
+    }
+
+    void chgthread()
+    {
+        this_worker->yield();
+    }
+}
+
+Config defaultConfig()
+{
+    Config config;
+    config.global_work_size = DEFAULT_WORK_SIZE;
+    config.stack_size       = DEFAULT_STACK;
+    config.pes_per_worker   = DEFAULT_PE_GROUP;
+
+    if (const char* env = std::getenv("PZCEMU_WORK_SIZE")) {
+        config.global_work_size = std::strtoul(env, nullptr, 10);
+    }
+    if (const char* env = std::getenv("PZCEMU_PES_PER_WORKER")) {
+        config.pes_per_worker = std::strtoul(env, nullptr, 10);
+    }
+    return config;
+}
+
+size_t localMemSize(const Config& config)
+{
+    const size_t stacks = THREAD_IN_PE * config.stack_size;
+    return stacks < SCRATCH_PAD_SIZE ? SCRATCH_PAD_SIZE - stacks : 0;
+}
+
+Stats launch(const Config& config, const std::function<void()>& kernel)
+{
+    const size_t work_size = config.global_work_size;
+    if (work_size == 0 || work_size % THREAD_IN_PE != 0) {
+        throw std::invalid_argument("pzcemu: global_work_size must be a positive multiple of 8");
+    }
+    if (!isPowerOfTwo(config.pes_per_worker)) {
+        throw std::invalid_argument("pzcemu: pes_per_worker must be a power of 2");
+    }
+    const size_t pe_count     = work_size / THREAD_IN_PE;
+    const size_t pe_group     = std::min(config.pes_per_worker, pe_count);
+    const size_t worker_count = (pe_count + pe_group - 1) / pe_group;
+
+    // Spinning only pays off while every worker has a core of its own.
+    const size_t   spin_count = worker_count <= std::thread::hardware_concurrency() ? 4096 : 16;
+    detail::Engine engine(pe_count, spin_count, kernel);
+
+    // Without local memory, get_local_mem_addr() is null.
+    const size_t                       local_mem_size = localMemSize(config);
+    std::vector<char>                  local_mem(local_mem_size * pe_count);
+    std::vector<detail::ThreadContext> contexts(work_size);
+    for (size_t gid = 0; gid < work_size; ++gid) {
+        auto& ctx     = contexts[gid];
+        ctx.pid       = static_cast<int>(gid / THREAD_IN_PE);
+        ctx.tid       = static_cast<int>(gid % THREAD_IN_PE);
+        ctx.maxpid    = static_cast<int>(pe_count);
+        ctx.local_mem = local_mem_size ? &local_mem[local_mem_size * ctx.pid] : nullptr;
+    }
+
+    std::vector<std::unique_ptr<detail::Worker>> workers;
+    for (size_t w = 0; w < worker_count; ++w) {
+        size_t first = w * pe_group * THREAD_IN_PE;
+        size_t count = std::min(pe_group * THREAD_IN_PE, work_size - first);
+        workers.emplace_back(new detail::Worker(engine, contexts.begin() + first, count));
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::thread> threads;
+    threads.reserve(worker_count);
+    for (auto& w : workers) {
+        detail::Worker* worker = w.get();
+        threads.emplace_back([worker] {
+            detail::this_worker = worker;
+            worker->run();
+            detail::this_worker = nullptr;
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    Stats stats   = {};
+    stats.elapsed = std::chrono::duration<double>(end - start).count();
+    for (const auto& w : workers) {
+        w->addStats(stats);
+    }
+    return stats;
+}
+}
@@ -0,0 +1,50 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Host emulator for pzc kernels
+ * @details   Runs a kernel compiled against include/pzc_builtin.h on CPU
+ *            threads. Each emulated hardware thread is a fiber; the fibers
+ *            of pes_per_worker PEs share one host thread and switch on
+ *            chgthread() and syncs.
+ */
+
+#ifndef PZCEMU_EMULATOR_HPP
+#define PZCEMU_EMULATOR_HPP
+
+#include <cstddef>
+#include <functional>
+
+namespace pzcemu {
+struct Config {
+    size_t global_work_size; // must be a multiple of 8 (threads in a PE)
+    size_t stack_size;       // bytes of each thread's stack, as set by pezy_set_per_thread_stack_size
+    size_t pes_per_worker;   // PEs run on one host thread, a power of 2
+};
+
+struct Stats {
+    double elapsed;  // seconds
+    double wait[4];  // seconds spent in syncs of each scope, summed over threads
+    size_t syncs[4]; // syncs of each scope, summed over threads
+};
+
+// Index of a pzcemu::Scope in Stats::wait and Stats::syncs.
+inline size_t scopeIndex(int scope)
+{
+    return scope - 1;
+}
+
+// Reads PZCEMU_WORK_SIZE and PZCEMU_PES_PER_WORKER from the environment.
+// Defaults are 1024 (128 PEs) and 16 (a city per host thread). Stacks are
+// the SC2 default of 2.5KB, which leave no local memory.
+Config defaultConfig();
+
+// Bytes at get_local_mem_addr() of each PE: the 20KB scratch pad of SC2
+// less the stacks of its 8 threads.
+size_t localMemSize(const Config& config);
+
+// Runs kernel on every emulated thread and waits for completion.
+Stats launch(const Config& config, const std::function<void()>& kernel);
+}
+
+#endif
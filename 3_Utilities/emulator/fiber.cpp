@@ -0,0 +1,147 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "fiber.hpp"
+
+#include <cstdint>
+#include <new>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+extern "C" {
+void pzcemu_switch_context(void** from_sp, void* to_sp);
+void pzcemu_fiber_start();
+}
+
+// Saves the callee-saved registers on the current stack, swaps stacks and
+// restores them from the other one. A new stack starts at
+// pzcemu_fiber_start, which calls r13 (entry) with r12 (arg).
+asm(R"(
+    .text
+    .globl pzcemu_switch_context
+    .type  pzcemu_switch_context, @function
+pzcemu_switch_context:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    movq  %rsp, (%rdi)
+    movq  %rsi, %rsp
+    popq  %r15
+    popq  %r14
+    popq  %r13
+    popq  %r12
+    popq  %rbx
+    popq  %rbp
+    ret
+    .size pzcemu_switch_context, .-pzcemu_switch_context
+
+    .globl pzcemu_fiber_start
+    .type  pzcemu_fiber_start, @function
+pzcemu_fiber_start:
+    movq  %r12, %rdi
+    call  *%r13
+    ud2
+    .size pzcemu_fiber_start, .-pzcemu_fiber_start
+)");
+#endif
+
+namespace pzcemu {
+namespace detail {
+    namespace {
+        size_t pageSize()
+        {
+            static const size_t size = sysconf(_SC_PAGESIZE);
+            return size;
+        }
+
+    }
+
+    FiberStacks::FiberStacks(size_t count, size_t stack_size_)
+        : addr(nullptr)
+        , length(0)
+        , base(nullptr)
+        , stack_size((stack_size_ + pageSize() - 1) / pageSize() * pageSize())
+    {
+        length  = count * stack_size + pageSize();
+        void* p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        // The lowest page is left inaccessible to catch overflows of stack 0.
+        mprotect(p, pageSize(), PROT_NONE);
+        addr = static_cast<char*>(p);
+        base = addr + pageSize();
+    }
+
+    FiberStacks::~FiberStacks()
+    {
+        munmap(addr, length);
+    }
+
+    Fiber::Fiber()
+        : entry(nullptr)
+        , arg(nullptr)
+        , stack(nullptr)
+        , stack_size(0)
+    {
+    }
+
+    Fiber::Fiber(Entry entry_, void* arg_, char* stack_, size_t stack_size_)
+        : entry(entry_)
+        , arg(arg_)
+        , stack(stack_)
+        , stack_size(stack_size_)
+    {
+#if defined(__x86_64__)
+        // Frame popped by pzcemu_switch_context:
+        // r15, r14, r13, r12, rbx, rbp, return address.
+        // The stack is 16 byte aligned at the call in pzcemu_fiber_start.
+        auto   top   = reinterpret_cast<uintptr_t>(stack + stack_size) & ~uintptr_t(15);
+        void** frame = reinterpret_cast<void**>(top - 9 * sizeof(void*));
+        frame[0]     = nullptr;
+        frame[1]     = nullptr;
+        frame[2]     = reinterpret_cast<void*>(entry);
+        frame[3]     = arg;
+        frame[4]     = nullptr;
+        frame[5]     = nullptr;
+        frame[6]     = reinterpret_cast<void*>(&pzcemu_fiber_start);
+        sp           = frame;
+#else
+        getcontext(&context);
+        context.uc_stack.ss_sp   = stack;
+        context.uc_stack.ss_size = stack_size;
+        context.uc_link          = nullptr;
+
+        // makecontext only passes int arguments.
+        auto self = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(this));
+        makecontext(&context, reinterpret_cast<void (*)()>(&startContext), 2,
+                    static_cast<unsigned>(self >> 32), static_cast<unsigned>(self));
+#endif
+    }
+
+    void Fiber::switchTo(Fiber& from, Fiber& to)
+    {
+#if defined(__x86_64__)
+        pzcemu_switch_context(&from.sp, to.sp);
+#else
+        swapcontext(&from.context, &to.context);
+#endif
+    }
+
+#if !defined(__x86_64__)
+    void Fiber::startContext(unsigned hi, unsigned lo)
+    {
+        auto* self = reinterpret_cast<Fiber*>(static_cast<uintptr_t>((static_cast<uint64_t>(hi) << 32) | lo));
+        self->entry(self->arg);
+    }
+#endif
+}
+}
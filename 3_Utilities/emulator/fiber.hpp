@@ -0,0 +1,79 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     User-space context switch
+ * @details   x86-64 uses a hand-written switch of the callee-saved
+ *            registers. Other architectures fall back to ucontext, which
+ *            also saves the signal mask and is much slower.
+ */
+
+#ifndef PZCEMU_FIBER_HPP
+#define PZCEMU_FIBER_HPP
+
+#include <cstddef>
+
+#if !defined(__x86_64__)
+#    include <ucontext.h>
+#endif
+
+namespace pzcemu {
+namespace detail {
+    // Stacks of count fibers in one mapping. Only the lowest page is a
+    // guard page: a guard page below every stack would split the mapping
+    // into two for each stack, and a full chip would need more mappings
+    // than vm.max_map_count allows. An overflow of stack i runs into
+    // stack i - 1 unnoticed, except for stack 0.
+    class FiberStacks {
+    public:
+        FiberStacks(size_t count, size_t stack_size);
+        ~FiberStacks();
+
+        FiberStacks(const FiberStacks&) = delete;
+        FiberStacks& operator=(const FiberStacks&) = delete;
+
+        char*  stack(size_t i) const { return base + i * stack_size; }
+        size_t stackSize() const { return stack_size; }
+
+    private:
+        char*  addr;
+        size_t length;
+        char*  base;
+        size_t stack_size;
+    };
+
+    class Fiber {
+    public:
+        typedef void (*Entry)(void* arg);
+
+        // Context of the calling OS thread. Only a target to switch back to.
+        Fiber();
+
+        // New context that runs entry(arg) on stack_size bytes at stack,
+        // owned by the caller. entry must never return; switch to another
+        // fiber instead.
+        Fiber(Entry entry, void* arg, char* stack, size_t stack_size);
+
+        Fiber(const Fiber&) = delete;
+        Fiber& operator=(const Fiber&) = delete;
+
+        // Saves the current context into from and resumes to.
+        static void switchTo(Fiber& from, Fiber& to);
+
+    private:
+        Entry  entry;
+        void*  arg;
+        char*  stack;
+        size_t stack_size;
+#if defined(__x86_64__)
+        void* sp;
+#else
+        ucontext_t context;
+
+        static void startContext(unsigned hi, unsigned lo);
+#endif
+    };
+}
+}
+
+#endif
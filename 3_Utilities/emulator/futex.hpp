@@ -0,0 +1,26 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     futex wrappers
+ * @details   Kept out of barrier.cpp because <unistd.h> declares a sync()
+ *            that conflicts with the one of the emulated pzc_builtin.h.
+ */
+
+#ifndef PZCEMU_FUTEX_HPP
+#define PZCEMU_FUTEX_HPP
+
+#include <atomic>
+#include <cstdint>
+
+namespace pzcemu {
+namespace detail {
+    // Sleeps while *word == expected.
+    void futexWait(std::atomic<uint32_t>* word, uint32_t expected);
+
+    // Wakes every thread sleeping on word.
+    void futexWakeAll(std::atomic<uint32_t>* word);
+}
+}
+
+#endif
@@ -0,0 +1,246 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Host emulation of pzc_builtin.h
+ * @details   Put this directory on the include path to compile the .pzc
+ *            sources of the samples with a host C++ compiler.
+ *            The kernels are executed by the runtime in emulator.hpp.
+ */
+
+#ifndef PZCEMU_PZC_BUILTIN_H
+#define PZCEMU_PZC_BUILTIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace pzcemu {
+// Synchronization scopes. Same numbering as __builtin_pz_sync_lv().
+enum Scope {
+    SCOPE_PE      = 1, //    8 threads
+    SCOPE_VILLAGE = 2, //   32 threads
+    SCOPE_CITY    = 3, //  128 threads
+    SCOPE_CHIP    = 4, //  all threads
+};
+
+namespace detail {
+    struct ThreadContext {
+        int   pid;
+        int   tid;
+        int   maxpid;
+        void* local_mem;
+    };
+
+    extern thread_local ThreadContext* current;
+
+    // Keeps the value argument of the atomics out of template deduction.
+    template <typename T>
+    struct NonDeduced {
+        typedef T type;
+    };
+
+    void sync(int level);
+    void chgthread();
+
+    template <typename T, typename F>
+    inline T atomicUpdate(T* p, F op)
+    {
+        T old = __atomic_load_n(p, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(p, &old, op(old), true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        }
+        return old;
+    }
+
+    // __atomic_compare_exchange_n does not accept floating point types.
+    template <typename F>
+    inline double atomicUpdate(double* p, F op)
+    {
+        uint64_t* q   = reinterpret_cast<uint64_t*>(p);
+        uint64_t  old = __atomic_load_n(q, __ATOMIC_RELAXED);
+        for (;;) {
+            double   o, n;
+            uint64_t nbits;
+            __builtin_memcpy(&o, &old, sizeof(o));
+            n = op(o);
+            __builtin_memcpy(&nbits, &n, sizeof(n));
+            if (__atomic_compare_exchange_n(q, &old, nbits, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                return o;
+            }
+        }
+    }
+
+    template <typename F>
+    inline float atomicUpdate(float* p, F op)
+    {
+        uint32_t* q   = reinterpret_cast<uint32_t*>(p);
+        uint32_t  old = __atomic_load_n(q, __ATOMIC_RELAXED);
+        for (;;) {
+            float    o, n;
+            uint32_t nbits;
+            __builtin_memcpy(&o, &old, sizeof(o));
+            n = op(o);
+            __builtin_memcpy(&nbits, &n, sizeof(n));
+            if (__atomic_compare_exchange_n(q, &old, nbits, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                return o;
+            }
+        }
+    }
+
+    template <typename T>
+    inline T fetchAdd(T* p, T v)
+    {
+        return __atomic_fetch_add(p, v, __ATOMIC_ACQ_REL);
+    }
+
+    inline double fetchAdd(double* p, double v)
+    {
+        return atomicUpdate(p, [v](double o) { return o + v; });
+    }
+
+    inline float fetchAdd(float* p, float v)
+    {
+        return atomicUpdate(p, [v](float o) { return o + v; });
+    }
+}
+}
+
+inline int get_pid()
+{
+    return pzcemu::detail::current->pid;
+}
+
+inline int get_tid()
+{
+    return pzcemu::detail::current->tid;
+}
+
+inline int get_maxpid()
+{
+    return pzcemu::detail::current->maxpid;
+}
+
+inline int get_maxtid()
+{
+    return 8;
+}
+
+inline void* get_local_mem_addr()
+{
+    return pzcemu::detail::current->local_mem;
+}
+
+// Switches to the next emulated thread on the same host thread.
+inline void chgthread()
+{
+    pzcemu::detail::chgthread();
+}
+
+// Syncs the threads in a PE.
+// Threads that have returned from the kernel or wait at a wider scope
+// do not hold back a sync.
+inline void sync()
+{
+    pzcemu::detail::sync(pzcemu::SCOPE_PE);
+}
+
+inline void flush()
+{
+    pzcemu::detail::sync(pzcemu::SCOPE_CHIP);
+}
+
+inline void flush_L1()
+{
+    pzcemu::detail::sync(pzcemu::SCOPE_PE);
+}
+
+inline void flush_L2()
+{
+    pzcemu::detail::sync(pzcemu::SCOPE_CITY);
+}
+
+// clang-format off
+#define __builtin_pz_sync_lv(lv)  pzcemu::detail::sync(lv)
+#define __builtin_pz_flush_lv(lv) pzcemu::detail::sync(lv)
+// clang-format on
+
+//
+// Atomic functions. Each returns the old value like OpenCL.
+//
+template <typename T>
+inline T pz_atomic_add(T* p, typename pzcemu::detail::NonDeduced<T>::type v)
+{
+    return pzcemu::detail::fetchAdd(p, v);
+}
+
+template <typename T>
+inline T pz_atomic_sub(T* p, typename pzcemu::detail::NonDeduced<T>::type v)
+{
+    return pzcemu::detail::fetchAdd(p, static_cast<T>(-v));
+}
+
+template <typename T>
+inline T pz_atomic_xchg(T* p, typename pzcemu::detail::NonDeduced<T>::type v)
+{
+    return pzcemu::detail::atomicUpdate(p, [v](T) { return v; });
+}
+
+template <typename T>
+inline T pz_atomic_inc(T* p)
+{
+    return __atomic_fetch_add(p, 1, __ATOMIC_ACQ_REL);
+}
+
+template <typename T>
+inline T pz_atomic_dec(T* p)
+{
+    return __atomic_fetch_sub(p, 1, __ATOMIC_ACQ_REL);
+}
+
+template <typename T>
+inline T pz_atomic_cmpxchg(T* p, typename pzcemu::detail::NonDeduced<T>::type cmp, typename pzcemu::detail::NonDeduced<T>::type v)
+{
+    return pzcemu::detail::atomicUpdate(p, [cmp, v](T o) { return o == cmp ? v : o; });
+}
+
+template <typename T>
+inline T pz_atomic_min(T* p, typename pzcemu::detail::NonDeduced<T>::type v)
+{
+    return pzcemu::detail::atomicUpdate(p, [v](T o) { return v < o ? v : o; });
+}
+
+template <typename T>
+inline T pz_atomic_max(T* p, typename pzcemu::detail::NonDeduced<T>::type v)
+{
+    return pzcemu::detail::atomicUpdate(p, [v](T o) { return o < v ? v : o; });
+}
+
+template <typename T>
+inline T pz_atomic_and(T* p, typename pzcemu::detail::NonDeduced<T>::type v)
+{
+    return __atomic_fetch_and(p, v, __ATOMIC_ACQ_REL);
+}
+
+template <typename T>
+inline T pz_atomic_or(T* p, typename pzcemu::detail::NonDeduced<T>::type v)
+{
+    return __atomic_fetch_or(p, v, __ATOMIC_ACQ_REL);
+}
+
+template <typename T>
+inline T pz_atomic_xor(T* p, typename pzcemu::detail::NonDeduced<T>::type v)
+{
+    return __atomic_fetch_xor(p, v, __ATOMIC_ACQ_REL);
+}
+
+template <typename T>
+inline T pz_atomic_load(T* p)
+{
+    return pzcemu::detail::atomicUpdate(p, [](T o) { return o; });
+}
+
+inline void pz_atomic_flush()
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#endif
@@ -0,0 +1,11 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include <pzc_builtin.h>
+
+namespace atomic {
+#include "../../../0_Intro/Atomic/pzc/kernel.pzc"
+}
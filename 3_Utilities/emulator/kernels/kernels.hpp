@@ -0,0 +1,112 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Kernels of the samples compiled for the emulator
+ * @details   Each kernel.pzc is wrapped in a namespace named after its
+ *            sample so that equally named kernels do not collide.
+ */
+
+#ifndef PZCEMU_KERNELS_HPP
+#define PZCEMU_KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace pzcAdd {
+void pzc_add(size_t num, double* dst, const double* src0, const double* src1);
+}
+
+namespace atomic {
+void pzc_atomic_add(const double* src, double* dst, size_t num);
+void pzc_atomic_add_hierarchical(const double* src, double* dst, size_t num);
+void pzc_histogram(uint32_t* bins, size_t num, const uint32_t* keys, uint32_t shift);
+void pzc_radix_sort_pass(uint32_t* dst, const uint32_t* src, size_t num, uint32_t shift, size_t* counts);
+}
+
+namespace multiDevice {
+void pzc_fill(size_t num, uint32_t* dst, uint32_t value);
+void pzc_fill_range(size_t offset, size_t num, uint32_t* dst, uint32_t value);
+}
+
+namespace reduction {
+void pzc_flush_LLC();
+void pzc_sum_simple(double* sum, size_t num, const double* data);
+void pzc_sum_base2(double* sum, size_t num, const double* data);
+void pzc_sum_base4(double* sum, size_t num, const double* data);
+void pzc_sum_base8(double* sum, size_t num, const double* data);
+void pzc_sum_kahan(double* sum, size_t num, const double* data);
+void pzc_sum_pairwise(double* sum, size_t num, const double* data);
+void pzc_sum_deterministic(double* sum, size_t num, const double* data, double* partial);
+
+template <typename T>
+struct ArgValue {
+    T    value;
+    long index;
+};
+
+void pzc_reduce_sum_double(double* result, size_t num, const double* data);
+void pzc_reduce_min_double(double* result, size_t num, const double* data);
+void pzc_reduce_max_double(double* result, size_t num, const double* data);
+void pzc_reduce_argmin_double(ArgValue<double>* result, size_t num, const double* data);
+void pzc_reduce_argmax_double(ArgValue<double>* result, size_t num, const double* data);
+void pzc_reduce_sum_int(long* result, size_t num, const int* data);
+void pzc_reduce_argmin_int(ArgValue<int>* result, size_t num, const int* data);
+void pzc_reduce_argmax_int(ArgValue<int>* result, size_t num, const int* data);
+void pzc_reduce_all_int(int* result, size_t num, const int* data);
+void pzc_reduce_any_int(int* result, size_t num, const int* data);
+void pzc_reduce_batched_sum_double(double* result, size_t count, const size_t* offsets, const double* data);
+void pzc_reduce_batched_argmin_int(ArgValue<int>* result, size_t count, const size_t* offsets, const int* data);
+void pzc_reduce_segmented_sum_double(double* result, size_t count, const size_t* offsets, const double* data);
+void pzc_reduce_segmented_argmin_int(ArgValue<int>* result, size_t count, const size_t* offsets, const int* data);
+void pzc_scan_inclusive_double(double* dst, const double* src, size_t num);
+void pzc_scan_exclusive_double(double* dst, const double* src, size_t num);
+void pzc_scan_inclusive_int(int* dst, const int* src, size_t num);
+}
+
+namespace pzcAddLocal {
+void pzc_addWithLocal(size_t num, double* dst, const double* src0, const double* src1, size_t stack_size);
+}
+
+namespace outOfCore {
+void pzc_add(size_t num, double* dst, const double* src0, const double* src1);
+void pzc_triad(double* a, const double* b, const double* c, double scalar, size_t num);
+void pzc_sum(double* sum, size_t num, const double* data);
+}
+
+namespace extProfile {
+void pzc_add(size_t num, double* dst, const double* src0, const double* src1);
+}
+
+namespace workQueue {
+void pzc_work_static(size_t num, double* dst, const double* src, const uint32_t* costs);
+void pzc_work_dynamic(size_t num, double* dst, const double* src, const uint32_t* costs, size_t* counter, size_t chunk);
+void pzc_work_guided(size_t num, double* dst, const double* src, const uint32_t* costs, size_t* counter, size_t chunk);
+}
+
+namespace atomicBench {
+void pzc_atomic_add_int(int* targets, size_t addresses, size_t stride, size_t iterations);
+void pzc_atomic_add_long(long* targets, size_t addresses, size_t stride, size_t iterations);
+void pzc_atomic_add_float(float* targets, size_t addresses, size_t stride, size_t iterations);
+void pzc_atomic_add_double(double* targets, size_t addresses, size_t stride, size_t iterations);
+void pzc_atomic_add_flush_int(int* targets, size_t addresses, size_t stride, size_t iterations);
+void pzc_atomic_add_flush_double(double* targets, size_t addresses, size_t stride, size_t iterations);
+void pzc_atomic_xchg_int(int* targets, size_t addresses, size_t stride, size_t iterations);
+void pzc_atomic_xchg_long(long* targets, size_t addresses, size_t stride, size_t iterations);
+void pzc_atomic_cmpxchg_int(int* targets, size_t addresses, size_t stride, size_t iterations);
+void pzc_atomic_cmpxchg_long(long* targets, size_t addresses, size_t stride, size_t iterations);
+void pzc_atomic_min_int(int* targets, size_t addresses, size_t stride, size_t iterations);
+void pzc_atomic_min_long(long* targets, size_t addresses, size_t stride, size_t iterations);
+void pzc_atomic_max_int(int* targets, size_t addresses, size_t stride, size_t iterations);
+void pzc_atomic_max_long(long* targets, size_t addresses, size_t stride, size_t iterations);
+}
+
+namespace stream {
+void pzc_Empty();
+void pzc_Copy(double* c, const double* a, size_t num);
+void pzc_Scale(double* b, const double* c, double scalar, size_t num);
+void pzc_Add(double* c, const double* a, const double* b, size_t num);
+void pzc_Triad(double* a, const double* b, const double* c, double scalar, size_t num);
+}
+
+#endif
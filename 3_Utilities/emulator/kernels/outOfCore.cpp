@@ -0,0 +1,11 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include <pzc_builtin.h>
+
+namespace outOfCore {
+#include "../../../2_Advanced/out_of_core/pzc/kernel.pzc"
+}
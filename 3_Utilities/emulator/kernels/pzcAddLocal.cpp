@@ -0,0 +1,11 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include <pzc_builtin.h>
+
+namespace pzcAddLocal {
+#include "../../../2_Advanced/pzcAdd_local/pzc/kernel.pzc"
+}
@@ -0,0 +1,484 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "emulator.hpp"
+#include "kernels/kernels.hpp"
+#include "scheduler.hpp"
+#include <pzc_builtin.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+std::mt19937 mt(0);
+inline void  initVector(std::vector<double>& src)
+{
+    std::uniform_real_distribution<> rnd01(0.0, 1.0);
+    for (auto& s : src) {
+        s = rnd01(mt);
+    }
+}
+
+bool verify(const std::vector<double>& actual, const std::vector<double>& expected)
+{
+    size_t error_count = 0;
+    for (size_t i = 0; i < actual.size(); ++i) {
+        if (std::fabs(actual[i] - expected[i]) > 1.e-7) {
+            if (error_count < 10) {
+                std::cerr << "# ERROR " << i << " " << actual[i] << " " << expected[i] << std::endl;
+            }
+            error_count++;
+        }
+    }
+    return error_count == 0;
+}
+
+bool verifySum(double actual, double expected)
+{
+    return std::fabs(expected - actual) / std::max(std::fabs(expected), std::fabs(actual)) <= 1e-8;
+}
+
+// config for a kernel the host gives stacks of stack_size bytes, which
+// sets its local memory.
+pzcemu::Config withStackSize(pzcemu::Config config, size_t stack_size)
+{
+    config.stack_size = stack_size;
+    return config;
+}
+
+class Runner {
+public:
+    explicit Runner(const pzcemu::Config& config_)
+        : config(config_)
+        , failed(0)
+    {
+    }
+
+    // Launch kernel and check the result with verify.
+    pzcemu::Stats run(const std::string& name, const std::function<void()>& kernel, const std::function<bool()>& verify)
+    {
+        return run(name, config, kernel, verify);
+    }
+
+    // As above, with launch_config instead of the config of the runner.
+    pzcemu::Stats run(const std::string& name, const pzcemu::Config& launch_config, const std::function<void()>& kernel, const std::function<bool()>& verify)
+    {
+        auto stats = pzcemu::launch(launch_config, kernel);
+        report(name, stats.elapsed, verify());
+        return stats;
+    }
+
+    void report(const std::string& name, double elapsed, bool ok)
+    {
+        if (!ok) {
+            failed++;
+        }
+        std::printf("%-36s %10.4f ms\t %s\n", name.c_str(), elapsed * 1000, ok ? "PASS" : "FAIL");
+    }
+
+    // Average time a thread spent in syncs of each scope.
+    void showWait(const pzcemu::Stats& stats) const
+    {
+        const char* names[] = { "PE", "village", "city", "chip" };
+        for (int scope = pzcemu::SCOPE_PE; scope <= pzcemu::SCOPE_CHIP; ++scope) {
+            size_t i = pzcemu::scopeIndex(scope);
+            if (stats.syncs[i] == 0) {
+                continue;
+            }
+            std::printf("    wait %-8s %10.4f ms\t %6zu syncs\n", names[i],
+                        stats.wait[i] / config.global_work_size * 1000, stats.syncs[i] / config.global_work_size);
+        }
+    }
+
+    int failures() const { return failed; }
+
+    const pzcemu::Config& getConfig() const { return config; }
+
+private:
+    pzcemu::Config config;
+    int            failed;
+};
+}
+
+int main(int argc, char** argv)
+{
+    size_t num = 102400;
+
+    if (argc > 1) {
+        num = strtol(argv[1], nullptr, 10);
+    }
+
+    const pzcemu::Config config = pzcemu::defaultConfig();
+
+    std::cout << "num        : " << num << std::endl;
+    std::cout << "workitem   : " << config.global_work_size << std::endl;
+
+    Runner runner(config);
+
+    std::vector<double> src0(num);
+    std::vector<double> src1(num);
+    initVector(src0);
+    initVector(src1);
+
+    // 0_Intro/pzcAdd, 2_Advanced/ext_profile and 2_Advanced/pzcAdd_local
+    {
+        std::vector<double> expected(num);
+        for (size_t i = 0; i < num; ++i) {
+            expected[i] = src0[i] + src1[i];
+        }
+
+        std::vector<double> dst(num, 0);
+        auto                check = [&] { return verify(dst, expected); };
+
+        runner.run("pzcAdd::add", [&] { pzcAdd::pzc_add(num, &dst[0], &src0[0], &src1[0]); }, check);
+
+        std::fill(dst.begin(), dst.end(), 0);
+        runner.run("ext_profile::add", [&] { extProfile::pzc_add(num, &dst[0], &src0[0], &src1[0]); }, check);
+
+        // Larger stacks give smaller tiles, 2.5KB none at all.
+        for (size_t stack_size : { 1024, 2048, 2560 }) {
+            std::fill(dst.begin(), dst.end(), 0);
+            runner.run("pzcAdd_local::addWithLocal/" + std::to_string(stack_size), withStackSize(config, stack_size),
+                       [&] { pzcAddLocal::pzc_addWithLocal(num, &dst[0], &src0[0], &src1[0], stack_size); }, check);
+        }
+    }
+
+    // 0_Intro/Atomic
+    {
+        double expected = 0.0;
+        for (auto s : src0) {
+            expected += s;
+        }
+
+        // The host clears dst, the kernels only add.
+        double dst = 0.0;
+        runner.run("Atomic::atomic_add", [&] { atomic::pzc_atomic_add(&src0[0], &dst, num); }, [&] { return verifySum(dst, expected); });
+        dst = 0.0;
+        runner.run("Atomic::atomic_add_hierarchical", [&] { atomic::pzc_atomic_add_hierarchical(&src0[0], &dst, num); }, [&] { return verifySum(dst, expected); });
+
+        std::vector<uint32_t>                   keys(num);
+        std::uniform_int_distribution<uint32_t> rnd;
+        for (auto& k : keys) {
+            k = rnd(mt);
+        }
+
+        std::vector<uint32_t> bins(256, 0), expected_bins(256, 0);
+        for (auto k : keys) {
+            expected_bins[(k >> 8) & 255]++;
+        }
+        // radix_sort.cpp gives both kernels 1KB stacks for their local bins.
+        const pzcemu::Config radix_config = withStackSize(config, 1024);
+        runner.run("Atomic::histogram", radix_config, [&] { atomic::pzc_histogram(&bins[0], num, &keys[0], 8); }, [&] { return bins == expected_bins; });
+
+        // Four 8-bit passes, back into keys
+        std::vector<uint32_t> sorted(keys), work(num);
+        std::vector<size_t>   counts(256 * config.global_work_size / 8);
+        runner.run("Atomic::radix_sort", radix_config,
+                   [&] {
+                       for (uint32_t shift = 0; shift < 32; shift += 16) {
+                           atomic::pzc_radix_sort_pass(&work[0], &sorted[0], num, shift, &counts[0]);
+                           atomic::pzc_radix_sort_pass(&sorted[0], &work[0], num, shift + 8, &counts[0]);
+                       }
+                   },
+                   [&] {
+                       std::sort(keys.begin(), keys.end());
+                       return sorted == keys;
+                   });
+    }
+
+    // 0_Intro/MultiDevice
+    {
+        const uint32_t        value = 1234;
+        std::vector<uint32_t> dst(num, 0);
+        runner.run("MultiDevice::fill", [&] { multiDevice::pzc_fill(num, &dst[0], value); },
+                   [&] {
+                       for (auto v : dst) {
+                           if (v != value) {
+                               return false;
+                           }
+                       }
+                       return true;
+                   });
+    }
+
+    // 0_Intro/MultiDevice work-stealing scheduler. Each emulated device is
+    // a host thread launching the kernel per chunk; device i is slowed down
+    // by 20i ms per chunk, so the faster ones have to steal.
+    {
+        const size_t          devices = 3;
+        const uint32_t        value   = 5678;
+        std::vector<uint32_t> dst(num, 0);
+        std::vector<size_t>   count(num, 0);
+        ChunkScheduler        scheduler(num, 4096, devices, 16);
+
+        const auto               begin = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < devices; ++i) {
+            threads.emplace_back([&, i] {
+                scheduler.work(i, [&](const Range& r) {
+                    pzcemu::launch(runner.getConfig(), [&] { multiDevice::pzc_fill_range(r.offset, r.size, &dst[0], value); });
+                    // Ranges never overlap, so the counts need no lock.
+                    for (size_t k = r.offset; k < r.offset + r.size; ++k) {
+                        count[k]++;
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(20 * i));
+                });
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        bool ok = true;
+        for (size_t k = 0; k < num; ++k) {
+            ok = ok && dst[k] == value && count[k] == 1;
+        }
+        runner.report("MultiDevice::fill_range", elapsed, ok);
+        for (size_t i = 0; i < devices; ++i) {
+            const auto s = scheduler.stats(i);
+            std::printf("    device %zu %12zu chunks\t %6zu stolen\t idle %8.4f ms\n", i, s.chunks, s.stolen, s.idle * 1000);
+        }
+    }
+
+    // 1_Basics/reduction
+    {
+        double expected = 0.0;
+        for (auto s : src0) {
+            expected += s;
+        }
+
+        typedef void (*SumKernel)(double*, size_t, const double*);
+        const std::vector<std::pair<std::string, SumKernel>> kernels = {
+            { "reduction::sum_simple", reduction::pzc_sum_simple },
+            { "reduction::sum_base2", reduction::pzc_sum_base2 },
+            { "reduction::sum_base4", reduction::pzc_sum_base4 },
+            { "reduction::sum_base8", reduction::pzc_sum_base8 },
+            { "reduction::sum_kahan", reduction::pzc_sum_kahan },
+            { "reduction::sum_pairwise", reduction::pzc_sum_pairwise },
+        };
+
+        for (const auto& k : kernels) {
+            double      actual = 0.0;
+            SumKernel   kernel = k.second;
+            const auto* data   = &src0[0];
+            auto        stats  = runner.run(k.first, [&] { kernel(&actual, num, data); }, [&] { return verifySum(actual, expected); });
+            runner.showWait(stats);
+        }
+
+        // The deterministic sum must not change with the work size.
+        std::vector<double> partial(std::max<size_t>((num + 1023) / 1024, 1));
+        double              reference = 0.0;
+        for (size_t work_size : { runner.getConfig().global_work_size, size_t(8), size_t(1016) }) {
+            pzcemu::Config config = runner.getConfig();
+            config.global_work_size = work_size;
+
+            double     actual = 0.0;
+            const auto stats  = pzcemu::launch(config, [&] { reduction::pzc_sum_deterministic(&actual, num, &src0[0], &partial[0]); });
+            const bool first  = work_size == runner.getConfig().global_work_size;
+            if (first) {
+                reference = actual;
+            }
+            runner.report(first ? "reduction::sum_deterministic" : "    work size " + std::to_string(work_size), stats.elapsed,
+                          verifySum(actual, expected) && actual == reference);
+        }
+
+        // Typed reductions, over double and over int with many ties
+        std::vector<int> isrc(num);
+        for (size_t i = 0; i < num; ++i) {
+            isrc[i] = static_cast<int>(src0[i] * 200) - 100;
+        }
+        const auto min_it  = std::min_element(src0.begin(), src0.end());
+        const auto max_it  = std::max_element(src0.begin(), src0.end());
+        const auto imin_it = std::min_element(isrc.begin(), isrc.end());
+        const auto imax_it = std::max_element(isrc.begin(), isrc.end());
+        long       isum    = 0;
+        for (auto x : isrc) {
+            isum += x;
+        }
+
+        double                      value = 0.0;
+        long                        lvalue = 0;
+        int                         flag   = 0;
+        reduction::ArgValue<double> arg    = {};
+        reduction::ArgValue<int>    iarg   = {};
+        runner.run("reduction::reduce_sum_double", [&] { reduction::pzc_reduce_sum_double(&value, num, &src0[0]); }, [&] { return verifySum(value, expected); });
+        runner.run("reduction::reduce_min_double", [&] { reduction::pzc_reduce_min_double(&value, num, &src0[0]); }, [&] { return value == *min_it; });
+        runner.run("reduction::reduce_max_double", [&] { reduction::pzc_reduce_max_double(&value, num, &src0[0]); }, [&] { return value == *max_it; });
+        runner.run("reduction::reduce_argmin_double", [&] { reduction::pzc_reduce_argmin_double(&arg, num, &src0[0]); },
+                   [&] { return arg.value == *min_it && arg.index == min_it - src0.begin(); });
+        runner.run("reduction::reduce_argmax_double", [&] { reduction::pzc_reduce_argmax_double(&arg, num, &src0[0]); },
+                   [&] { return arg.value == *max_it && arg.index == max_it - src0.begin(); });
+        runner.run("reduction::reduce_sum_int", [&] { reduction::pzc_reduce_sum_int(&lvalue, num, &isrc[0]); }, [&] { return lvalue == isum; });
+        runner.run("reduction::reduce_argmin_int", [&] { reduction::pzc_reduce_argmin_int(&iarg, num, &isrc[0]); },
+                   [&] { return iarg.value == *imin_it && iarg.index == imin_it - isrc.begin(); });
+        runner.run("reduction::reduce_argmax_int", [&] { reduction::pzc_reduce_argmax_int(&iarg, num, &isrc[0]); },
+                   [&] { return iarg.value == *imax_it && iarg.index == imax_it - isrc.begin(); });
+        runner.run("reduction::reduce_all_int", [&] { reduction::pzc_reduce_all_int(&flag, num, &isrc[0]); },
+                   [&] { return (flag != 0) == std::all_of(isrc.begin(), isrc.end(), [](int x) { return x != 0; }); });
+        runner.run("reduction::reduce_any_int", [&] { reduction::pzc_reduce_any_int(&flag, num, &isrc[0]); },
+                   [&] { return (flag != 0) == std::any_of(isrc.begin(), isrc.end(), [](int x) { return x != 0; }); });
+
+        // Batched, segments at random cut points
+        const size_t                          count = 1000;
+        std::vector<size_t>                   offsets(count + 1);
+        std::uniform_int_distribution<size_t> rnd(0, num);
+        for (size_t k = 1; k < count; ++k) {
+            offsets[k] = rnd(mt);
+        }
+        offsets[count] = num;
+        std::sort(offsets.begin(), offsets.end());
+
+        std::vector<double>                   sums(count);
+        std::vector<reduction::ArgValue<int>> iargs(count);
+        // Checks per-segment sums and argmins of both batched kinds
+        auto verifySegmentSums = [&] {
+            bool ok = true;
+            for (size_t k = 0; k < count; ++k) {
+                double e = 0.0;
+                for (size_t i = offsets[k]; i < offsets[k + 1]; ++i) {
+                    e += src0[i];
+                }
+                ok = ok && (e == sums[k] || verifySum(sums[k], e));
+            }
+            return ok;
+        };
+        auto verifySegmentArgmins = [&] {
+            bool ok = true;
+            for (size_t k = 0; k < count; ++k) {
+                const auto first = isrc.begin() + offsets[k];
+                const auto it    = std::min_element(first, isrc.begin() + offsets[k + 1]);
+                ok               = ok && (it == isrc.begin() + offsets[k + 1] ? iargs[k].index == __LONG_MAX__ : iargs[k].value == *it && iargs[k].index == it - first);
+            }
+            return ok;
+        };
+        runner.run("reduction::reduce_batched_sum", [&] { reduction::pzc_reduce_batched_sum_double(&sums[0], count, &offsets[0], &src0[0]); }, verifySegmentSums);
+        runner.run("reduction::reduce_batched_argmin", [&] { reduction::pzc_reduce_batched_argmin_int(&iargs[0], count, &offsets[0], &isrc[0]); }, verifySegmentArgmins);
+        runner.run("reduction::reduce_segmented_sum", [&] { reduction::pzc_reduce_segmented_sum_double(&sums[0], count, &offsets[0], &src0[0]); }, verifySegmentSums);
+        runner.run("reduction::reduce_segmented_argmin", [&] { reduction::pzc_reduce_segmented_argmin_int(&iargs[0], count, &offsets[0], &isrc[0]); }, verifySegmentArgmins);
+
+        // Scans, the int one in place
+        std::vector<double> scan(num);
+        std::vector<int>    iscan(isrc);
+        auto                verifyScan = [&](bool inclusive) {
+            double acc = 0.0;
+            bool   ok  = true;
+            for (size_t i = 0; i < num; ++i) {
+                if (inclusive) {
+                    acc += src0[i];
+                }
+                ok = ok && (acc == scan[i] || std::fabs(acc - scan[i]) <= 1e-10 * acc);
+                if (!inclusive) {
+                    acc += src0[i];
+                }
+            }
+            return ok;
+        };
+        runner.run("reduction::scan_inclusive", [&] { reduction::pzc_scan_inclusive_double(&scan[0], &src0[0], num); }, [&] { return verifyScan(true); });
+        runner.run("reduction::scan_exclusive", [&] { reduction::pzc_scan_exclusive_double(&scan[0], &src0[0], num); }, [&] { return verifyScan(false); });
+        runner.run("reduction::scan_inclusive_int", [&] { reduction::pzc_scan_inclusive_int(&iscan[0], &iscan[0], num); }, [&] {
+            int  acc = 0;
+            bool ok  = true;
+            for (size_t i = 0; i < num; ++i) {
+                acc += isrc[i];
+                ok = ok && iscan[i] == acc;
+            }
+            return ok;
+        });
+    }
+
+    // 2_Advanced/out_of_core, in windows of a quarter of the array
+    {
+        const size_t window = std::max<size_t>(num / 4, 1);
+        const double scalar = 3.0;
+
+        std::vector<double> add(num, 0), triad(num, 0);
+        std::vector<double> expected_add(num), expected_triad(num);
+        double              expected_sum = 0.0;
+        for (size_t i = 0; i < num; ++i) {
+            expected_add[i]   = src0[i] + src1[i];
+            expected_triad[i] = src0[i] + scalar * src1[i];
+            expected_sum += src0[i];
+        }
+
+        double elapsed[3] = { 0.0, 0.0, 0.0 };
+        double sum        = 0.0;
+        for (size_t offset = 0; offset < num; offset += window) {
+            const size_t n = std::min(window, num - offset);
+            elapsed[0] += pzcemu::launch(config, [&] { outOfCore::pzc_add(n, &add[offset], &src0[offset], &src1[offset]); }).elapsed;
+            elapsed[1] += pzcemu::launch(config, [&] { outOfCore::pzc_triad(&triad[offset], &src0[offset], &src1[offset], scalar, n); }).elapsed;
+            elapsed[2] += pzcemu::launch(config, [&] { outOfCore::pzc_sum(&sum, n, &src0[offset]); }).elapsed;
+        }
+        runner.report("out_of_core::add", elapsed[0], verify(add, expected_add));
+        runner.report("out_of_core::triad", elapsed[1], verify(triad, expected_triad));
+        runner.report("out_of_core::sum", elapsed[2], verifySum(sum, expected_sum));
+    }
+
+    // 2_Advanced/work_queue, regions of 256 items costing 10 or, one in 8,
+    // 1000 steps each
+    {
+        std::uniform_int_distribution<uint32_t> rnd(0, 7);
+        std::vector<uint32_t>                   costs(num);
+        for (size_t first = 0; first < num; first += 256) {
+            const uint32_t cost = rnd(mt) == 0 ? 1000 : 10;
+            std::fill(costs.begin() + first, costs.begin() + std::min<size_t>(first + 256, num), cost);
+        }
+
+        std::vector<double> expected(num);
+        for (size_t i = 0; i < num; ++i) {
+            double x = src0[i];
+            for (uint32_t k = 0; k < costs[i]; ++k) {
+                x = x * 0.999 + 0.001;
+            }
+            expected[i] = x;
+        }
+
+        std::vector<double> dst(num, 0);
+        size_t              counter = 0;
+        auto                check   = [&] { return verify(dst, expected); };
+
+        runner.run("work_queue::work_static", [&] { workQueue::pzc_work_static(num, &dst[0], &src0[0], &costs[0]); }, check);
+        std::fill(dst.begin(), dst.end(), 0);
+        runner.run("work_queue::work_dynamic", [&] { workQueue::pzc_work_dynamic(num, &dst[0], &src0[0], &costs[0], &counter, 16); }, check);
+        std::fill(dst.begin(), dst.end(), 0);
+        counter = 0;
+        runner.run("work_queue::work_guided", [&] { workQueue::pzc_work_guided(num, &dst[0], &src0[0], &costs[0], &counter, 16); }, check);
+    }
+
+    // 3_Utilities/stream
+    {
+        const double        scalar = 3.0;
+        std::vector<double> a(num, 2.0);
+        std::vector<double> b(num, 2.0);
+        std::vector<double> c(num, 0.0);
+
+        auto filled = [](const std::vector<double>& v, double expected) {
+            return verify(v, std::vector<double>(v.size(), expected));
+        };
+
+        runner.run("stream::Copy", [&] { stream::pzc_Copy(&c[0], &a[0], num); }, [&] { return filled(c, 2.0); });
+        runner.run("stream::Scale", [&] { stream::pzc_Scale(&b[0], &c[0], scalar, num); }, [&] { return filled(b, 6.0); });
+        runner.run("stream::Add", [&] { stream::pzc_Add(&c[0], &a[0], &b[0], num); }, [&] { return filled(c, 8.0); });
+        runner.run("stream::Triad", [&] { stream::pzc_Triad(&a[0], &b[0], &c[0], scalar, num); }, [&] { return filled(a, 30.0); });
+    }
+
+    if (runner.failures() == 0) {
+        std::cout << "PASS" << std::endl;
+        return 0;
+    } else {
+        std::cout << "FAIL" << std::endl;
+        return 1;
+    }
+}
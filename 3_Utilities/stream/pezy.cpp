@@ -6,52 +6,11 @@
 
 #include "pezy.hpp"
 #include <chrono>
-#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
 
 namespace {
-inline size_t getFileSize(std::ifstream& file)
-{
-    file.seekg(0, std::ios::end);
-    size_t ret = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    return ret;
-}
-
-inline void loadFile(std::ifstream& file, std::vector<char>& d, size_t size)
-{
-    d.resize(size);
-    file.read(reinterpret_cast<char*>(d.data()), size);
-}
-
-cl::Program createProgram(cl::Context& context, const std::vector<cl::Device>& devices, const std::string& filename)
-{
-    std::ifstream file;
-    file.open(filename, std::ios::in | std::ios::binary);
-
-    if (file.fail()) {
-        throw "can not open kernel file";
-    }
-
-    size_t            filesize = getFileSize(file);
-    std::vector<char> binary_data;
-    loadFile(file, binary_data, filesize);
-
-    cl::Program::Binaries binaries;
-    binaries.push_back(std::make_pair(&binary_data[0], filesize));
-
-    return cl::Program(context, devices, binaries, nullptr, nullptr);
-}
-
-cl::Program createProgram(cl::Context& context, const cl::Device& device, const std::string& filename)
-{
-    std::vector<cl::Device> devices { device };
-    return createProgram(context, devices, filename);
-}
-
 double empty_kernel_execute_time = 0;
 
 void checkSTREAMresults(const double* a, const double* b, const double* c,
@@ -180,26 +139,14 @@ pezy::pezy(size_t device_id)
 void pezy::init(size_t device_id)
 {
     try {
-        // Get Platform
-        std::vector<cl::Platform> platforms;
-        cl::Platform::get(&platforms);
-        const auto& Platform = platforms[0];
-
-        // Get devices
-        std::vector<cl::Device> devices;
-        Platform.getDevices(CL_DEVICE_TYPE_DEFAULT, &devices);
-
-        if (device_id > devices.size()) {
-            std::cerr << "Invalid device id. Use first device." << std::endl;
-            device_id = 0;
-        }
+        pzcl::Runtime runtime(device_id);
 
-        const auto& device = devices[device_id];
+        context          = runtime.context;
+        queue            = runtime.queue;
+        global_work_size = runtime.global_work_size;
+        buffers.reset(new pzcl::BufferPool(context));
 
-        context = cl::Context(device);
-        queue   = cl::CommandQueue(context, device, 0);
-
-        auto program = createProgram(context, device, "kernel/kernel.pz");
+        auto program = runtime.loadProgram("kernel/kernel.pz");
 
         kernels.push_back(cl::Kernel(program, "Empty"));
         kernels.push_back(cl::Kernel(program, "Copy"));
@@ -217,24 +164,7 @@ void pezy::init(size_t device_id)
             throw cl::Error(-1, "clExtSetCacheWriteBuffer failed");
         }
 
-        // Get global work size.
-        // sc1-64: 8192  (1024 PEs * 8 threads)
-        // sc2   : 15782 (1984 PEs * 8 threads)
-        {
-            std::string device_name;
-            device.getInfo(CL_DEVICE_NAME, &device_name);
-
-            size_t global_work_size_[3] = { 0 };
-            device.getInfo(CL_DEVICE_MAX_WORK_ITEM_SIZES, &global_work_size_);
-
-            global_work_size = global_work_size_[0];
-            if (device_name.find("PEZY-SC2") != std::string::npos) {
-                global_work_size = std::min(global_work_size, (size_t)15872);
-            }
-
-            std::cout << "Use device : " << device_name << std::endl;
-            std::cout << "workitem   : " << global_work_size << std::endl;
-        }
+        runtime.showDeviceInfo();
     } catch (const cl::Error& e) {
         std::stringstream msg;
         msg << "CL Error : " << e.what() << " " << e.err();
@@ -272,10 +202,13 @@ std::vector<std::vector<double>> pezy::run(size_t STREAM_ARRAY_SIZE, size_t NTIM
         }
         empty_kernel_execute_time /= static_cast<double>(NTIMES);
 
-        // create device buffer & write
-        auto d_a = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(double) * allocate_num);
-        auto d_b = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(double) * allocate_num);
-        auto d_c = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(double) * allocate_num);
+        // get device buffer & write
+        auto  pooled_a = buffers->acquire(sizeof(double) * allocate_num);
+        auto  pooled_b = buffers->acquire(sizeof(double) * allocate_num);
+        auto  pooled_c = buffers->acquire(sizeof(double) * allocate_num);
+        auto& d_a      = pooled_a.get();
+        auto& d_b      = pooled_b.get();
+        auto& d_c      = pooled_c.get();
 
         queue.enqueueWriteBuffer(d_a, true, 0, sizeof(double) * allocate_num, h_a);
         queue.enqueueWriteBuffer(d_b, true, 0, sizeof(double) * allocate_num, h_b);
@@ -7,9 +7,10 @@
 #ifndef PEZY_HPP
 #define PEZY_HPP
 
+#include "pzcl_buffer_pool.hpp"
+#include "pzcl_runtime.hpp"
 #include <cstddef>
-#define __CL_ENABLE_EXCEPTIONS
-#include <CL/cl.hpp>
+#include <memory>
 #include <vector>
 
 class pezy {
@@ -33,6 +34,9 @@ private:
     cl::CommandQueue        queue;
     std::vector<cl::Kernel> kernels;
     size_t                  global_work_size;
+
+    // Device arrays, kept for later runs of the same size class.
+    std::unique_ptr<pzcl::BufferPool> buffers;
 };
 
 #endif
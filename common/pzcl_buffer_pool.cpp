@@ -0,0 +1,136 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "pzcl_buffer_pool.hpp"
+#include <algorithm>
+
+namespace pzcl {
+constexpr size_t BufferPool::MIN_SIZE_CLASS;
+constexpr size_t BufferPool::DEFAULT_CAPACITY;
+
+BufferPool::Buffer::Buffer(BufferPool& pool_, const cl::Buffer& buffer_, size_t size_class_, size_t requested_)
+    : pool(&pool_)
+    , buffer(buffer_)
+    , size_class(size_class_)
+    , requested(requested_)
+{
+}
+
+BufferPool::Buffer::Buffer(Buffer&& other)
+    : pool(other.pool)
+    , buffer(other.buffer)
+    , size_class(other.size_class)
+    , requested(other.requested)
+{
+    other.pool = nullptr;
+}
+
+BufferPool::Buffer::~Buffer()
+{
+    if (pool) {
+        pool->release(buffer, size_class);
+    }
+}
+
+BufferPool::BufferPool(const cl::Context& context_, size_t capacity_, cl_mem_flags flags_)
+    : context(context_)
+    , flags(flags_)
+    , capacity(capacity_)
+    , idle_bytes(0)
+    , hit_count(0)
+    , miss_count(0)
+{
+}
+
+size_t BufferPool::sizeClass(size_t size)
+{
+    size_t c = MIN_SIZE_CLASS;
+    while (c < size) {
+        c <<= 1;
+    }
+    return c;
+}
+
+BufferPool::Buffer BufferPool::acquire(size_t size)
+{
+    // Too large to be kept: allocate the exact size, not a whole class.
+    const size_t c = sizeClass(size);
+    if (c > capacity) {
+        std::lock_guard<std::mutex> lock(mutex);
+        miss_count++;
+        return Buffer(*this, cl::Buffer(context, flags, std::max<size_t>(size, 1)), 0, size);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto it = idle.find(c);
+        if (it != idle.end() && !it->second.empty()) {
+            // Take the most recently released one, likely still warm.
+            Idle i = it->second.back();
+            it->second.pop_back();
+            lru.erase(i.lru);
+            idle_bytes -= c;
+            hit_count++;
+            return Buffer(*this, i.buffer, c, size);
+        }
+        miss_count++;
+    }
+
+    // Allocate outside the lock.
+    return Buffer(*this, cl::Buffer(context, flags, c), c, size);
+}
+
+void BufferPool::release(const cl::Buffer& buffer, size_t size_class)
+{
+    if (size_class == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    lru.push_front(size_class);
+    idle[size_class].push_back(Idle{ buffer, lru.begin() });
+    idle_bytes += size_class;
+
+    trimLocked(capacity);
+}
+
+void BufferPool::trim(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    trimLocked(bytes);
+}
+
+void BufferPool::trimLocked(size_t bytes)
+{
+    // The oldest entry of lru is also the oldest of its size class.
+    while (idle_bytes > bytes) {
+        const size_t c = lru.back();
+        lru.pop_back();
+        idle[c].pop_front();
+        idle_bytes -= c;
+    }
+}
+
+size_t BufferPool::hits() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return hit_count;
+}
+
+size_t BufferPool::misses() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return miss_count;
+}
+
+size_t BufferPool::idleBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return idle_bytes;
+}
+}
@@ -0,0 +1,94 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Recycles device buffers of one context
+ * @details   Requests are rounded up to a power of two, so a released
+ *            buffer serves any later request of the same size class. Idle
+ *            buffers are kept up to a byte cap, dropping the least
+ *            recently released first; a request larger than the cap gets
+ *            an exact-size buffer that is never kept. A buffer must only be
+ *            released when no queued command uses it any more.
+ */
+
+#ifndef PZCL_BUFFER_POOL_HPP
+#define PZCL_BUFFER_POOL_HPP
+
+#include "pzcl_runtime.hpp"
+#include <cstddef>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+
+namespace pzcl {
+class BufferPool {
+public:
+    // Gives the buffer back to the pool on destruction.
+    class Buffer {
+    public:
+        Buffer(Buffer&& other);
+        ~Buffer();
+
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+
+        cl::Buffer&       get() { return buffer; }
+        const cl::Buffer& get() const { return buffer; }
+
+        // Requested size. The buffer itself may be larger.
+        size_t size() const { return requested; }
+
+    private:
+        friend class BufferPool;
+        Buffer(BufferPool& pool, const cl::Buffer& buffer, size_t size_class, size_t requested);
+
+        BufferPool* pool;
+        cl::Buffer  buffer;
+        size_t      size_class;
+        size_t      requested;
+    };
+
+    static constexpr size_t MIN_SIZE_CLASS   = 4096;
+    static constexpr size_t DEFAULT_CAPACITY = size_t(256) << 20;
+
+    // capacity: bytes of idle buffers kept. Thread-safe.
+    explicit BufferPool(const cl::Context& context, size_t capacity = DEFAULT_CAPACITY, cl_mem_flags flags = CL_MEM_READ_WRITE);
+
+    Buffer acquire(size_t size);
+
+    // Releases idle buffers, least recently used first, until at most
+    // bytes are kept.
+    void trim(size_t bytes);
+
+    size_t hits() const;
+    size_t misses() const;
+    size_t idleBytes() const;
+
+    // Smallest power of two >= size, at least MIN_SIZE_CLASS.
+    static size_t sizeClass(size_t size);
+
+private:
+    typedef std::list<size_t> LruList; // size classes, most recent first
+
+    struct Idle {
+        cl::Buffer        buffer;
+        LruList::iterator lru;
+    };
+
+    void release(const cl::Buffer& buffer, size_t size_class);
+    void trimLocked(size_t bytes);
+
+    cl::Context                        context;
+    cl_mem_flags                       flags;
+    size_t                             capacity;
+    mutable std::mutex                 mutex;
+    std::map<size_t, std::deque<Idle>> idle; // oldest first per class
+    LruList                            lru;
+    size_t                             idle_bytes;
+    size_t                             hit_count;
+    size_t                             miss_count;
+};
+}
+
+#endif
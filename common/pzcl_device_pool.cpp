@@ -0,0 +1,130 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "pzcl_device_pool.hpp"
+#include <iostream>
+
+namespace pzcl {
+cl::Kernel& PooledDevice::kernel(const std::string& name)
+{
+    auto it = kernels.find(name);
+    if (it == kernels.end()) {
+        it = kernels.emplace(name, cl::Kernel(program, name.c_str())).first;
+    }
+    return it->second;
+}
+
+void PooledDevice::showDeviceInfo() const
+{
+    std::cout << "Use device : " << device_name << std::endl;
+    std::cout << "workitem   : " << global_work_size << std::endl;
+}
+
+DevicePool::Lease::Lease(DevicePool& pool_, const Key& key_, std::unique_ptr<PooledDevice> device_)
+    : pool(&pool_)
+    , key(key_)
+    , device(std::move(device_))
+{
+}
+
+DevicePool::Lease::Lease(Lease&& other)
+    : pool(other.pool)
+    , key(std::move(other.key))
+    , device(std::move(other.device))
+{
+}
+
+DevicePool::Lease::~Lease()
+{
+    if (device) {
+        pool->checkin(key, std::move(device));
+    }
+}
+
+DevicePool& DevicePool::instance()
+{
+    // Never destroyed: releasing OpenCL objects from a static destructor
+    // may run after the runtime itself has been torn down.
+    static DevicePool* pool = new DevicePool;
+    return *pool;
+}
+
+DevicePool::DevicePool()
+    : created_count(0)
+{
+}
+
+DevicePool::Lease DevicePool::checkout(size_t device_id, const std::string& filename, cl_command_queue_properties properties)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (devices.empty()) {
+        devices = getDevices();
+    }
+    if (device_id >= devices.size()) {
+        std::cerr << "Invalid device id. Use first device." << std::endl;
+        device_id = 0;
+    }
+
+    const Key key(device_id, filename, properties);
+    auto&     list = idle[key];
+    if (!list.empty()) {
+        std::unique_ptr<PooledDevice> device = std::move(list.back());
+        list.pop_back();
+        return Lease(*this, key, std::move(device));
+    }
+
+    // Setup happens under the lock, but only once per concurrent user.
+    return Lease(*this, key, create(key));
+}
+
+size_t DevicePool::created() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return created_count;
+}
+
+std::unique_ptr<PooledDevice> DevicePool::create(const Key& key)
+{
+    const size_t       device_id  = std::get<0>(key);
+    const std::string& filename   = std::get<1>(key);
+    const auto         properties = std::get<2>(key);
+
+    std::unique_ptr<PooledDevice> d(new PooledDevice);
+    d->device = devices[device_id];
+
+    // One context, buffer pool and pinned pool per device and one program
+    // per file, shared by the queues of that device.
+    auto context = contexts.find(device_id);
+    if (context == contexts.end()) {
+        context = contexts.emplace(device_id, cl::Context(d->device)).first;
+        buffers.emplace(device_id, std::make_shared<BufferPool>(context->second));
+        pinned.emplace(device_id, std::make_shared<PinnedPool>(context->second));
+    }
+    d->context = context->second;
+    d->buffers = buffers[device_id];
+    d->pinned  = pinned[device_id];
+
+    auto program = programs.find(std::make_pair(device_id, filename));
+    if (program == programs.end()) {
+        program = programs.emplace(std::make_pair(device_id, filename), createProgram(d->context, d->device, filename)).first;
+    }
+    d->program = program->second;
+
+    d->queue            = cl::CommandQueue(d->context, d->device, properties);
+    d->global_work_size = getGlobalWorkSize(d->device);
+    d->device.getInfo(CL_DEVICE_NAME, &d->device_name);
+
+    created_count++;
+    return d;
+}
+
+void DevicePool::checkin(const Key& key, std::unique_ptr<PooledDevice> device)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    idle[key].push_back(std::move(device));
+}
+}
@@ -0,0 +1,108 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Process-wide pool of device contexts, queues and kernels
+ * @details   Creating a context, loading a program and creating kernels
+ *            costs far more than a small kernel launch. The pool creates
+ *            them on first use and hands them out again on later calls.
+ *            A checked out PooledDevice belongs to one thread until its
+ *            Lease is destroyed, so its queue and kernel arguments are
+ *            never shared.
+ */
+
+#ifndef PZCL_DEVICE_POOL_HPP
+#define PZCL_DEVICE_POOL_HPP
+
+#include "pzcl_buffer_pool.hpp"
+#include "pzcl_pinned_pool.hpp"
+#include "pzcl_runtime.hpp"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace pzcl {
+// Command queue and kernels of one device and program.
+class PooledDevice {
+public:
+    // Kernel by name without pzc_ prefix, created on first use.
+    // Arguments set by a previous user are still there.
+    cl::Kernel& kernel(const std::string& name);
+
+    // Prints the device name and the work item count.
+    void showDeviceInfo() const;
+
+    cl::Device       device;
+    cl::Context      context;
+    cl::CommandQueue queue;
+    cl::Program      program;
+    std::string      device_name;
+    size_t           global_work_size;
+
+    // Device buffers and pinned host memory of the context, shared by all
+    // queues of the device.
+    std::shared_ptr<BufferPool> buffers;
+    std::shared_ptr<PinnedPool> pinned;
+
+private:
+    std::map<std::string, cl::Kernel> kernels;
+};
+
+class DevicePool {
+    typedef std::tuple<size_t, std::string, cl_command_queue_properties> Key;
+
+public:
+    // Gives a PooledDevice back to the pool on destruction. Finish the
+    // queue before that; the next user gets it as it is.
+    class Lease {
+    public:
+        Lease(Lease&& other);
+        ~Lease();
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        PooledDevice* operator->() const { return device.get(); }
+        PooledDevice& operator*() const { return *device; }
+
+    private:
+        friend class DevicePool;
+        Lease(DevicePool& pool, const Key& key, std::unique_ptr<PooledDevice> device);
+
+        DevicePool*                   pool;
+        Key                           key;
+        std::unique_ptr<PooledDevice> device;
+    };
+
+    // The pool shared by the whole process.
+    static DevicePool& instance();
+
+    // An idle PooledDevice for device_id (the first device if out of range),
+    // the program in filename and queue properties, or a new one if all are
+    // in use. Thread-safe.
+    Lease checkout(size_t device_id = 0, const std::string& filename = "kernel/kernel.pz", cl_command_queue_properties properties = 0);
+
+    // Number of PooledDevices created so far.
+    size_t created() const;
+
+private:
+    DevicePool();
+
+    std::unique_ptr<PooledDevice> create(const Key& key);
+    void                          checkin(const Key& key, std::unique_ptr<PooledDevice> device);
+
+    mutable std::mutex                                        mutex;
+    std::vector<cl::Device>                                   devices;
+    std::map<size_t, cl::Context>                             contexts;
+    std::map<size_t, std::shared_ptr<BufferPool>>             buffers;
+    std::map<size_t, std::shared_ptr<PinnedPool>>             pinned;
+    std::map<std::pair<size_t, std::string>, cl::Program>     programs;
+    std::map<Key, std::vector<std::unique_ptr<PooledDevice>>> idle;
+    size_t                                                    created_count;
+};
+}
+
+#endif
@@ -0,0 +1,142 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "pzcl_out_of_core.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+constexpr size_t WINDOW_ALIGN = 512;
+
+std::runtime_error systemError(const std::string& what, const std::string& filename)
+{
+    return std::runtime_error(what + " " + filename + ": " + std::strerror(errno));
+}
+
+// madvise wants a page-aligned start.
+void advise(const void* addr, size_t size, int advice)
+{
+    if (size == 0) {
+        return;
+    }
+    const uintptr_t page  = sysconf(_SC_PAGESIZE);
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(addr) / page * page;
+    const uintptr_t end   = reinterpret_cast<uintptr_t>(addr) + size;
+    madvise(reinterpret_cast<void*>(begin), end - begin, advice);
+}
+}
+
+namespace pzcl {
+MappedOutputFile::MappedOutputFile(const std::string& filename, size_t size)
+    : addr(nullptr)
+    , length(size)
+{
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw systemError("can not open", filename);
+    }
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        throw systemError("can not resize", filename);
+    }
+
+    // An empty file has nothing to map.
+    if (size > 0) {
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            throw systemError("can not map", filename);
+        }
+        addr = p;
+    }
+    close(fd);
+}
+
+MappedOutputFile::~MappedOutputFile()
+{
+    if (addr) {
+        munmap(addr, length);
+    }
+}
+
+void adviseSequential(const void* addr, size_t size)
+{
+    advise(addr, size, MADV_SEQUENTIAL);
+}
+
+MappedInputFile::MappedInputFile(const std::string& filename)
+    : file(filename)
+    , lock_mode(NOT_LOCKED)
+{
+    adviseSequential(file.data(), file.size());
+}
+
+MappedInputFile::MappedInputFile(const std::string& filename, const cl::Context& context_)
+    : MappedInputFile(filename)
+{
+    context   = context_;
+    void* ptr = const_cast<void*>(file.data());
+
+    // Locking faults every page in, reading the whole file now.
+    PezyExtMemLock mem_lock = getMemLock();
+    if (mem_lock && getMemUnLock()) {
+        if (mem_lock(context(), ptr, file.size()) == CL_SUCCESS) {
+            lock_mode = PEZY_MEM_LOCK;
+        }
+    } else if (mlock(ptr, file.size()) == 0) {
+        lock_mode = MLOCK;
+    }
+    if (lock_mode == NOT_LOCKED) {
+        std::cerr << "Can not lock " << filename << ", use pageable memory" << std::endl;
+    }
+}
+
+MappedInputFile::~MappedInputFile()
+{
+    void* ptr = const_cast<void*>(file.data());
+    if (lock_mode == PEZY_MEM_LOCK) {
+        getMemUnLock()(context(), ptr, file.size());
+    } else if (lock_mode == MLOCK) {
+        munlock(ptr, file.size());
+    }
+}
+
+void MappedInputFile::prefetch(size_t offset, size_t size) const
+{
+    if (offset >= file.size()) {
+        return;
+    }
+    size = std::min(size, file.size() - offset);
+    advise(static_cast<const char*>(file.data()) + offset, size, MADV_WILLNEED);
+}
+
+cl::Event MappedInputFile::enqueueWrite(cl::CommandQueue& queue, const cl::Buffer& buffer, size_t offset, size_t size, const std::vector<cl::Event>& wait) const
+{
+    cl::Event event;
+    queue.enqueueWriteBuffer(buffer, false, 0, size, static_cast<const char*>(file.data()) + offset, &wait, &event);
+    return event;
+}
+
+size_t getWindowSize(const cl::Device& device, size_t element_size, size_t arrays, size_t depth)
+{
+    cl_ulong global_mem_size = 0;
+    cl_ulong max_alloc_size  = 0;
+    device.getInfo(CL_DEVICE_GLOBAL_MEM_SIZE, &global_mem_size);
+    device.getInfo(CL_DEVICE_MAX_MEM_ALLOC_SIZE, &max_alloc_size);
+
+    const size_t in_flight = std::max<size_t>(arrays * depth, 1);
+    size_t       window    = static_cast<size_t>(global_mem_size / 2 / in_flight / element_size);
+    window                 = std::min(window, static_cast<size_t>(max_alloc_size / element_size));
+    return std::max(window / WINDOW_ALIGN * WINDOW_ALIGN, WINDOW_ALIGN);
+}
+}
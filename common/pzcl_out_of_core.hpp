@@ -0,0 +1,90 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Helpers for arrays larger than device memory
+ * @details   Inputs and outputs live in memory-mapped files and go through
+ *            the device one window at a time, so host and device memory
+ *            use stays bounded whatever the array size. Inputs are written
+ *            to the device straight from the mapping, without first being
+ *            read or copied into a host array.
+ */
+
+#ifndef PZCL_OUT_OF_CORE_HPP
+#define PZCL_OUT_OF_CORE_HPP
+
+#include "pzcl_runtime.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace pzcl {
+// Read-only mapping of an input file, written to device buffers in place.
+class MappedInputFile {
+public:
+    // Hints sequential access to the whole file.
+    explicit MappedInputFile(const std::string& filename);
+
+    // Also locks all pages for transfers of context with pezy_mem_lock (or
+    // mlock), so the file must fit in host memory. Falls back to unlocked
+    // pages if locking fails.
+    MappedInputFile(const std::string& filename, const cl::Context& context);
+    ~MappedInputFile();
+
+    MappedInputFile(const MappedInputFile&) = delete;
+    MappedInputFile& operator=(const MappedInputFile&) = delete;
+
+    const void* data() const { return file.data(); }
+    size_t      size() const { return file.size(); }
+    bool        locked() const { return lock_mode != NOT_LOCKED; }
+
+    // Starts reading bytes [offset, offset + size) in the background,
+    // widened to whole pages. Call it for the next chunk while the current
+    // one is transferred.
+    void prefetch(size_t offset, size_t size) const;
+
+    // Enqueues a write of bytes [offset, offset + size) of the file to the
+    // start of buffer, directly from the mapping.
+    cl::Event enqueueWrite(cl::CommandQueue& queue, const cl::Buffer& buffer, size_t offset, size_t size, const std::vector<cl::Event>& wait) const;
+
+private:
+    enum LockMode {
+        NOT_LOCKED,
+        PEZY_MEM_LOCK,
+        MLOCK
+    };
+
+    MappedFile  file;
+    cl::Context context;
+    LockMode    lock_mode;
+};
+
+// Read-write shared mapping of a file created (or truncated) to size bytes.
+// Writes reach the file as the kernel writes back dirty pages.
+class MappedOutputFile {
+public:
+    MappedOutputFile(const std::string& filename, size_t size);
+    ~MappedOutputFile();
+
+    MappedOutputFile(const MappedOutputFile&) = delete;
+    MappedOutputFile& operator=(const MappedOutputFile&) = delete;
+
+    void*  data() const { return addr; }
+    size_t size() const { return length; }
+
+private:
+    void*  addr;
+    size_t length;
+};
+
+// Tells the kernel the mapping is read front to back, so it reads ahead
+// and drops pages behind. Only a hint: errors are ignored.
+void adviseSequential(const void* addr, size_t size);
+
+// Elements per window so that depth windows of arrays arrays of
+// element_size bytes take at most half of the device memory, and one
+// array of a window fits in a single allocation. A multiple of 512.
+size_t getWindowSize(const cl::Device& device, size_t element_size, size_t arrays, size_t depth);
+}
+
+#endif
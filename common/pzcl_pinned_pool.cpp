@@ -0,0 +1,146 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "pzcl_pinned_pool.hpp"
+#include <algorithm>
+#include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+size_t pageSize()
+{
+    static const size_t size = sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+size_t roundUp(size_t n, size_t unit)
+{
+    return (n + unit - 1) / unit * unit;
+}
+}
+
+namespace pzcl {
+constexpr size_t PinnedPool::DEFAULT_BLOCK_SIZE;
+
+PinnedPool::PinnedPool(const cl::Context& context_, size_t block_size_)
+    : context(context_)
+    , block_size(roundUp(block_size_, pageSize()))
+    , mode(MLOCK)
+    , clExtMemLock(getMemLock())
+    , clExtMemUnLock(getMemUnLock())
+    , next(nullptr)
+    , remaining(0)
+{
+    if (clExtMemLock && clExtMemUnLock) {
+        mode = PEZY_MEM_LOCK;
+    }
+}
+
+PinnedPool::~PinnedPool()
+{
+    for (const auto& b : blocks) {
+        if (b.locked) {
+            if (mode == PEZY_MEM_LOCK) {
+                clExtMemUnLock(context(), b.addr, b.size);
+            } else {
+                munlock(b.addr, b.size);
+            }
+        }
+        munmap(b.addr, b.size);
+    }
+}
+
+size_t PinnedPool::sizeClass(size_t bytes)
+{
+    // Slices of a page or more are whole pages, so they stay page-aligned.
+    size_t c = 64;
+    while (c < bytes) {
+        c <<= 1;
+    }
+    return c;
+}
+
+PinnedPool::Block PinnedPool::newBlock(size_t size)
+{
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+
+    Block b = { static_cast<char*>(p), size, true };
+    if (mode == PEZY_MEM_LOCK) {
+        if (clExtMemLock(context(), b.addr, b.size) != CL_SUCCESS) {
+            munmap(b.addr, b.size);
+            throw cl::Error(-2, "clExtMemLock: Can not lock mem");
+        }
+    } else if (mlock(b.addr, b.size) != 0) {
+        if (mode == MLOCK) {
+            std::cerr << "PinnedPool: mlock failed, use pageable memory" << std::endl;
+        }
+        mode     = UNLOCKED;
+        b.locked = false;
+    }
+    blocks.push_back(b);
+    return b;
+}
+
+void* PinnedPool::allocate(size_t bytes)
+{
+    const size_t                c = sizeClass(bytes);
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto& list = free_slices[c];
+    if (!list.empty()) {
+        void* p = list.back();
+        list.pop_back();
+        return p;
+    }
+
+    if (c > block_size) {
+        return newBlock(roundUp(c, pageSize())).addr;
+    }
+
+    // Page-sized and larger slices start on a page boundary.
+    const size_t align = std::min(c, pageSize());
+    const size_t pad   = roundUp(reinterpret_cast<size_t>(next), align) - reinterpret_cast<size_t>(next);
+    if (next == nullptr || remaining < pad + c) {
+        Block b   = newBlock(block_size);
+        next      = b.addr;
+        remaining = b.size;
+    } else {
+        next += pad;
+        remaining -= pad;
+    }
+
+    void* p = next;
+    next += c;
+    remaining -= c;
+    return p;
+}
+
+void PinnedPool::deallocate(void* ptr, size_t bytes)
+{
+    if (ptr == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    free_slices[sizeClass(bytes)].push_back(ptr);
+}
+
+size_t PinnedPool::lockedBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    size_t bytes = 0;
+    for (const auto& b : blocks) {
+        if (b.locked) {
+            bytes += b.size;
+        }
+    }
+    return bytes;
+}
+}
@@ -0,0 +1,134 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Pinned host memory for transfers
+ * @details   Transfers from locked (pinned) host memory are faster than from
+ *            pageable memory, but locking is a system call. PinnedPool
+ *            allocates page-aligned blocks, locks each once with
+ *            pezy_mem_lock, and hands out slices of them; freed slices are
+ *            reused and everything is unlocked when the pool is destroyed.
+ *            Without the PEZY extension the blocks are locked with mlock.
+ *            PinnedAllocator makes std::vector use the pool.
+ */
+
+#ifndef PZCL_PINNED_POOL_HPP
+#define PZCL_PINNED_POOL_HPP
+
+#include "pzcl_runtime.hpp"
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace pzcl {
+class PinnedPool {
+public:
+    enum LockMode {
+        PEZY_MEM_LOCK, // locked for the context by the runtime
+        MLOCK,         // locked by the OS only
+        UNLOCKED       // mlock failed, e.g. RLIMIT_MEMLOCK
+    };
+
+    static constexpr size_t DEFAULT_BLOCK_SIZE = size_t(64) << 20;
+
+    // Requests larger than block_size get a block of their own. Thread-safe.
+    // All memory is released by the destructor, so the pool must outlive
+    // every container using it.
+    explicit PinnedPool(const cl::Context& context, size_t block_size = DEFAULT_BLOCK_SIZE);
+    ~PinnedPool();
+
+    PinnedPool(const PinnedPool&) = delete;
+    PinnedPool& operator=(const PinnedPool&) = delete;
+
+    // Page-aligned for requests of a page or more. Throws std::bad_alloc.
+    void* allocate(size_t bytes);
+    void  deallocate(void* ptr, size_t bytes);
+
+    LockMode lockMode() const { return mode; }
+    size_t   lockedBytes() const;
+
+private:
+    struct Block {
+        char*  addr;
+        size_t size;
+        bool   locked;
+    };
+
+    static size_t sizeClass(size_t bytes);
+
+    Block newBlock(size_t size);
+
+    cl::Context                          context;
+    size_t                               block_size;
+    LockMode                             mode;
+    PezyExtMemLock                       clExtMemLock; // null without the extension
+    PezyExtMemUnLock                     clExtMemUnLock;
+    mutable std::mutex                   mutex;
+    std::vector<Block>                   blocks;
+    char*                                next; // unused tail of the last block
+    size_t                               remaining;
+    std::map<size_t, std::vector<void*>> free_slices;
+};
+
+// std::vector<T, PinnedAllocator<T>> takes its memory from a PinnedPool.
+// A default constructed allocator uses ordinary pageable memory.
+template <typename T>
+class PinnedAllocator {
+public:
+    typedef T value_type;
+
+    PinnedAllocator()
+        : pool(nullptr)
+    {
+    }
+
+    explicit PinnedAllocator(PinnedPool* pool_)
+        : pool(pool_)
+    {
+    }
+
+    template <typename U>
+    PinnedAllocator(const PinnedAllocator<U>& other)
+        : pool(other.pool)
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        if (pool) {
+            return static_cast<T*>(pool->allocate(n * sizeof(T)));
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        if (pool) {
+            pool->deallocate(p, n * sizeof(T));
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    PinnedPool* pool;
+};
+
+template <typename T, typename U>
+bool operator==(const PinnedAllocator<T>& a, const PinnedAllocator<U>& b)
+{
+    return a.pool == b.pool;
+}
+
+template <typename T, typename U>
+bool operator!=(const PinnedAllocator<T>& a, const PinnedAllocator<U>& b)
+{
+    return a.pool != b.pool;
+}
+
+template <typename T>
+using PinnedVector = std::vector<T, PinnedAllocator<T>>;
+}
+
+#endif
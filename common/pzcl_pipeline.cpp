@@ -0,0 +1,62 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "pzcl_pipeline.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace pzcl {
+Pipeline::Pipeline(const cl::Context& context, const cl::Device& device, size_t depth_)
+    : slots(depth_)
+    , upload_queue(context, device)
+    , compute_queue(context, device)
+    , download_queue(context, device)
+{
+    if (slots == 0) {
+        throw std::invalid_argument("Pipeline: depth must be at least 1");
+    }
+}
+
+void Pipeline::run(size_t n, size_t chunk_size, const Stage& upload, const Stage& compute, const Stage& download)
+{
+    if (chunk_size == 0) {
+        throw std::invalid_argument("Pipeline: chunk size must be at least 1");
+    }
+
+    // Download event of the chunk last using each slot.
+    std::vector<cl::Event> slot_free(slots);
+    std::vector<bool>      slot_used(slots, false);
+
+    const size_t count = (n + chunk_size - 1) / chunk_size;
+    for (size_t k = 0; k < count; ++k) {
+        Chunk c;
+        c.index  = k;
+        c.offset = k * chunk_size;
+        c.size   = std::min(chunk_size, n - c.offset);
+        c.slot   = k % slots;
+
+        std::vector<cl::Event> wait;
+        if (slot_used[c.slot]) {
+            wait.push_back(slot_free[c.slot]);
+        }
+        cl::Event uploaded = upload(c, upload_queue, wait);
+        cl::Event computed = compute(c, compute_queue, { uploaded });
+        cl::Event done     = download(c, download_queue, { computed });
+
+        slot_free[c.slot] = done;
+        slot_used[c.slot] = true;
+
+        // Start the commands now rather than at the final finish.
+        upload_queue.flush();
+        compute_queue.flush();
+        download_queue.flush();
+    }
+
+    upload_queue.finish();
+    compute_queue.finish();
+    download_queue.finish();
+}
+}
@@ -0,0 +1,54 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Overlaps transfers with kernels on chunks of a large array
+ * @details   The array is processed in chunks, each going through upload,
+ *            compute and download on three command queues, ordered by
+ *            events. With depth chunks in flight, chunk k+1 is uploaded
+ *            while chunk k computes and chunk k-1 is downloaded, so the
+ *            total time approaches the slowest stage instead of the sum.
+ *            Chunk k uses buffer slot k % depth, which it may reuse once
+ *            chunk k-depth has been downloaded.
+ */
+
+#ifndef PZCL_PIPELINE_HPP
+#define PZCL_PIPELINE_HPP
+
+#include "pzcl_runtime.hpp"
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace pzcl {
+class Pipeline {
+public:
+    struct Chunk {
+        size_t index;
+        size_t offset; // first element in the whole array
+        size_t size;   // elements, at most the chunk size
+        size_t slot;   // buffer set to use, index % depth
+    };
+
+    // Enqueues one stage of chunk on queue, after the events in wait, and
+    // returns the event of its last command. Must not block.
+    typedef std::function<cl::Event(const Chunk& chunk, cl::CommandQueue& queue, const std::vector<cl::Event>& wait)> Stage;
+
+    // depth: chunks in flight, 2 for double and 3 for triple buffering.
+    Pipeline(const cl::Context& context, const cl::Device& device, size_t depth = 2);
+
+    size_t depth() const { return slots; }
+
+    // Runs the stages over [0, n) in chunks of chunk_size elements and
+    // waits for the last download.
+    void run(size_t n, size_t chunk_size, const Stage& upload, const Stage& compute, const Stage& download);
+
+private:
+    size_t           slots;
+    cl::CommandQueue upload_queue;
+    cl::CommandQueue compute_queue;
+    cl::CommandQueue download_queue;
+};
+}
+
+#endif
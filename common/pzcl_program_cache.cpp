@@ -0,0 +1,236 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "pzcl_program_cache.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+const char MAGIC[8] = { 'P', 'Z', 'C', 'L', 'B', 'I', 'N', '1' };
+
+// Layout of a cache entry: Header, key, binary.
+struct Header {
+    char     magic[8];
+    uint64_t key_size;
+    uint64_t binary_size;
+};
+
+std::runtime_error systemError(const std::string& what, const std::string& filename)
+{
+    return std::runtime_error(what + " " + filename + ": " + std::strerror(errno));
+}
+
+std::string getDeviceString(const cl::Device& device, cl_device_info name)
+{
+    std::string value;
+    device.getInfo(name, &value);
+    return value;
+}
+
+// Everything the binary depends on. The driver version stands for the SDK.
+std::string makeKey(const cl::Device& device, const std::string& source, const std::string& options)
+{
+    const std::string fields[] = {
+        getDeviceString(device, CL_DEVICE_NAME),
+        getDeviceString(device, CL_DEVICE_VERSION),
+        getDeviceString(device, CL_DRIVER_VERSION),
+        options,
+        source,
+    };
+
+    std::string key;
+    for (const auto& f : fields) {
+        key += f;
+        key.push_back('\0');
+    }
+    return key;
+}
+
+// 64-bit FNV-1a. Collisions are caught by comparing the stored key.
+std::string hashKey(const std::string& key)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : key) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(h));
+    return buf;
+}
+
+void makeDirectories(const std::string& path)
+{
+    size_t pos = 0;
+    do {
+        pos             = path.find('/', pos + 1);
+        std::string dir = path.substr(0, pos);
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw systemError("can not create", dir);
+        }
+    } while (pos != std::string::npos);
+}
+
+bool fileExists(const std::string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+cl::Program buildFromSource(const cl::Context& context, const cl::Device& device, const std::string& source, const std::string& options)
+{
+    cl::Program program(context, source);
+    try {
+        program.build({ device }, options.c_str());
+    } catch (const cl::Error&) {
+        std::string log;
+        program.getBuildInfo(device, CL_PROGRAM_BUILD_LOG, &log);
+        std::cerr << log << std::endl;
+        throw;
+    }
+    return program;
+}
+
+// Binary of a program built for a single device.
+std::vector<char> getBinary(const cl::Program& program)
+{
+    size_t size = 0;
+    cl_int ret  = clGetProgramInfo(program(), CL_PROGRAM_BINARY_SIZES, sizeof(size), &size, nullptr);
+    if (ret != CL_SUCCESS) {
+        throw cl::Error(ret, "clGetProgramInfo(CL_PROGRAM_BINARY_SIZES)");
+    }
+
+    std::vector<char> binary(size);
+    unsigned char*    ptr = reinterpret_cast<unsigned char*>(binary.data());
+    ret                   = clGetProgramInfo(program(), CL_PROGRAM_BINARIES, sizeof(ptr), &ptr, nullptr);
+    if (ret != CL_SUCCESS) {
+        throw cl::Error(ret, "clGetProgramInfo(CL_PROGRAM_BINARIES)");
+    }
+    return binary;
+}
+
+bool load(const std::string& path, const std::string& key, const cl::Context& context, const cl::Device& device, const std::string& options, cl::Program& program)
+{
+    if (!fileExists(path)) {
+        return false;
+    }
+
+    pzcl::MappedFile file(path);
+    const char*      data = static_cast<const char*>(file.data());
+
+    Header header;
+    if (file.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+        || header.key_size != key.size()
+        || file.size() != sizeof(header) + header.key_size + header.binary_size
+        || std::memcmp(data + sizeof(header), key.data(), key.size()) != 0) {
+        return false;
+    }
+
+    program = pzcl::createProgram(context, { device }, data + sizeof(header) + header.key_size, header.binary_size);
+    program.build({ device }, options.c_str());
+    return true;
+}
+
+// Renames a complete temporary file into place, so that runs sharing
+// the directory never read a partial entry.
+void store(const std::string& directory, const std::string& path, const std::string& key, const std::vector<char>& binary)
+{
+    makeDirectories(directory);
+
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.key_size    = key.size();
+    header.binary_size = binary.size();
+
+    const std::string tmp = path + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream file(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(key.data(), key.size());
+        file.write(binary.data(), binary.size());
+        if (!file) {
+            std::remove(tmp.c_str());
+            throw systemError("can not write", tmp);
+        }
+    }
+
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        throw systemError("can not rename", tmp);
+    }
+}
+}
+
+namespace pzcl {
+ProgramCache::ProgramCache()
+    : ProgramCache(defaultDirectory())
+{
+}
+
+ProgramCache::ProgramCache(const std::string& directory_)
+    : directory(directory_)
+    , hit_count(0)
+    , miss_count(0)
+{
+}
+
+std::string ProgramCache::defaultDirectory()
+{
+    if (const char* env = std::getenv("PZCL_PROGRAM_CACHE_DIR")) {
+        return env;
+    }
+    if (const char* home = std::getenv("HOME")) {
+        return std::string(home) + "/.cache/pzcl";
+    }
+    return ".pzcl_cache";
+}
+
+cl::Program ProgramCache::build(const cl::Context& context, const cl::Device& device, const std::string& source, const std::string& options)
+{
+    const std::string key  = makeKey(device, source, options);
+    const std::string path = directory + "/" + hashKey(key) + ".bin";
+
+    // A broken entry is only a miss.
+    cl::Program program;
+    try {
+        if (load(path, key, context, device, options, program)) {
+            hit_count++;
+            return program;
+        }
+    } catch (const cl::Error& e) {
+        std::cerr << "Ignore program cache " << path << ": " << e.what() << " " << e.err() << std::endl;
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Ignore program cache " << path << ": " << e.what() << std::endl;
+    }
+
+    miss_count++;
+    program = buildFromSource(context, device, source, options);
+
+    try {
+        store(directory, path, key, getBinary(program));
+    } catch (const cl::Error& e) {
+        std::cerr << "Can not store program cache: " << e.what() << " " << e.err() << std::endl;
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Can not store program cache: " << e.what() << std::endl;
+    }
+    return program;
+}
+}
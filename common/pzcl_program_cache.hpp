@@ -0,0 +1,40 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     On-disk cache of programs built from source
+ * @details   A program built online is saved as its device binary, keyed by
+ *            the source, the build options, the device and the driver
+ *            version. Later runs map the binary instead of compiling again.
+ */
+
+#ifndef PZCL_PROGRAM_CACHE_HPP
+#define PZCL_PROGRAM_CACHE_HPP
+
+#include "pzcl_runtime.hpp"
+#include <cstddef>
+#include <string>
+
+namespace pzcl {
+class ProgramCache {
+public:
+    // Cache directory is $PZCL_PROGRAM_CACHE_DIR, or ~/.cache/pzcl by default.
+    ProgramCache();
+    explicit ProgramCache(const std::string& directory);
+
+    // Returns the program built from source for device, from the cache if possible.
+    cl::Program build(const cl::Context& context, const cl::Device& device, const std::string& source, const std::string& options = "");
+
+    size_t hits() const { return hit_count; }
+    size_t misses() const { return miss_count; }
+
+    static std::string defaultDirectory();
+
+private:
+    std::string directory;
+    size_t      hit_count;
+    size_t      miss_count;
+};
+}
+
+#endif
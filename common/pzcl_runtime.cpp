@@ -0,0 +1,167 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "pzcl_runtime.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+constexpr size_t SC2_MAX_WORK_SIZE = 15872;
+
+std::runtime_error systemError(const std::string& what, const std::string& filename)
+{
+    return std::runtime_error(what + " " + filename + ": " + std::strerror(errno));
+}
+
+size_t selectDevice(size_t device_id, size_t device_count)
+{
+    if (device_id >= device_count) {
+        std::cerr << "Invalid device id. Use first device." << std::endl;
+        return 0;
+    }
+    return device_id;
+}
+}
+
+namespace pzcl {
+std::vector<cl::Device> getDevices(cl_device_type type)
+{
+    // Get Platform
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+    if (platforms.empty()) {
+        throw cl::Error(-1, "No platform found");
+    }
+
+    // Get devices
+    std::vector<cl::Device> devices;
+    platforms[0].getDevices(type, &devices);
+    if (devices.empty()) {
+        throw cl::Error(-1, "No devices found");
+    }
+    return devices;
+}
+
+size_t getGlobalWorkSize(const cl::Device& device)
+{
+    std::string device_name;
+    device.getInfo(CL_DEVICE_NAME, &device_name);
+
+    size_t global_work_size_[3] = { 0 };
+    device.getInfo(CL_DEVICE_MAX_WORK_ITEM_SIZES, &global_work_size_);
+
+    size_t global_work_size = global_work_size_[0];
+    if (device_name.find("PEZY-SC2") != std::string::npos) {
+        global_work_size = std::min(global_work_size, SC2_MAX_WORK_SIZE);
+    }
+    return global_work_size;
+}
+
+PezyExtMemLock getMemLock()
+{
+    return (PezyExtMemLock)clGetExtensionFunctionAddress("pezy_mem_lock");
+}
+
+PezyExtMemUnLock getMemUnLock()
+{
+    return (PezyExtMemUnLock)clGetExtensionFunctionAddress("pezy_mem_unlock");
+}
+
+void setPerThreadStackSize(const cl::Kernel& kernel, size_t size)
+{
+    auto clExtSetPerThreadStackSize = (PezyExtSetPerThreadStackSize)clGetExtensionFunctionAddress("pezy_set_per_thread_stack_size");
+    if (clExtSetPerThreadStackSize == nullptr) {
+        throw cl::Error(-1, "clGetExtensionFunctionAddress: Can not get pezy_set_per_thread_stack_size");
+    }
+    cl_int err = clExtSetPerThreadStackSize(kernel(), size);
+    if (err != CL_SUCCESS) {
+        throw cl::Error(err, "clExtSetPerThreadStackSize failed");
+    }
+}
+
+MappedFile::MappedFile(const std::string& filename)
+    : addr(nullptr)
+    , length(0)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw systemError("can not open", filename);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        throw systemError("can not read", filename);
+    }
+
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        throw systemError("can not map", filename);
+    }
+
+    addr   = p;
+    length = st.st_size;
+}
+
+MappedFile::~MappedFile()
+{
+    munmap(addr, length);
+}
+
+cl::Program createProgram(const cl::Context& context, const std::vector<cl::Device>& devices, const void* binary, size_t size)
+{
+    cl::Program::Binaries binaries;
+    for (size_t i = 0; i < devices.size(); ++i) {
+        binaries.push_back(std::make_pair(binary, size));
+    }
+
+    return cl::Program(context, devices, binaries, nullptr, nullptr);
+}
+
+cl::Program createProgram(const cl::Context& context, const std::vector<cl::Device>& devices, const std::string& filename)
+{
+    // The runtime copies the binary, so the mapping can go right after.
+    MappedFile file(filename);
+    return createProgram(context, devices, file.data(), file.size());
+}
+
+cl::Program createProgram(const cl::Context& context, const cl::Device& device, const std::string& filename)
+{
+    std::vector<cl::Device> devices { device };
+    return createProgram(context, devices, filename);
+}
+
+Runtime::Runtime(size_t device_id_, cl_command_queue_properties properties)
+{
+    const auto devices = getDevices();
+
+    device_id        = selectDevice(device_id_, devices.size());
+    device           = devices[device_id];
+    context          = cl::Context(device);
+    queue            = cl::CommandQueue(context, device, properties);
+    global_work_size = getGlobalWorkSize(device);
+    device.getInfo(CL_DEVICE_NAME, &device_name);
+}
+
+cl::Program Runtime::loadProgram(const std::string& filename) const
+{
+    return createProgram(context, device, filename);
+}
+
+void Runtime::showDeviceInfo() const
+{
+    std::cout << "Use device : " << device_name << std::endl;
+    std::cout << "workitem   : " << global_work_size << std::endl;
+}
+}
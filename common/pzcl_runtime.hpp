@@ -0,0 +1,88 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Host runtime shared by the samples
+ * @details   Device and queue setup, kernel binary loading and the work item
+ *            count of a device. Link with libpzclruntime.a.
+ */
+
+#ifndef PZCL_RUNTIME_HPP
+#define PZCL_RUNTIME_HPP
+
+#define __CL_ENABLE_EXCEPTIONS
+#include <CL/cl.hpp>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace pzcl {
+// Devices of the first platform. Throws cl::Error if there is none.
+std::vector<cl::Device> getDevices(cl_device_type type = CL_DEVICE_TYPE_DEFAULT);
+
+// Number of work items to launch on device.
+// sc1-64: 8192  (1024 PEs * 8 threads)
+// sc2   : 15872 (1984 PEs * 8 threads)
+size_t getGlobalWorkSize(const cl::Device& device);
+
+// pezy_mem_lock / pezy_mem_unlock: (un)locks host memory for transfers of
+// a context. Null if the runtime has no such extension.
+typedef CL_API_ENTRY cl_int(CL_API_CALL* PezyExtMemLock)(cl_context, void*, size_t);
+typedef CL_API_ENTRY cl_int(CL_API_CALL* PezyExtMemUnLock)(cl_context, void*, size_t);
+
+PezyExtMemLock   getMemLock();
+PezyExtMemUnLock getMemUnLock();
+
+// pezy_set_per_thread_stack_size: stack bytes of each thread of a kernel.
+// The stacks of the 8 threads of a PE take the top of its scratch pad
+// (20KB on SC2, 16KB on SC), the rest is local memory of the kernel.
+typedef CL_API_ENTRY cl_int(CL_API_CALL* PezyExtSetPerThreadStackSize)(cl_kernel, size_t);
+
+// Sets the stack size of kernel. Throws cl::Error without the extension.
+void setPerThreadStackSize(const cl::Kernel& kernel, size_t size);
+
+// Read-only mapping of a whole file.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const void* data() const { return addr; }
+    size_t      size() const { return length; }
+
+private:
+    void*  addr;
+    size_t length;
+};
+
+// Creates cl::Program from a kernel binary in memory.
+cl::Program createProgram(const cl::Context& context, const std::vector<cl::Device>& devices, const void* binary, size_t size);
+
+// Creates cl::Program from a compiled kernel binary file.
+cl::Program createProgram(const cl::Context& context, const std::vector<cl::Device>& devices, const std::string& filename);
+cl::Program createProgram(const cl::Context& context, const cl::Device& device, const std::string& filename);
+
+// Context and command queue of one device.
+class Runtime {
+public:
+    // Uses the first device if device_id is out of range.
+    explicit Runtime(size_t device_id = 0, cl_command_queue_properties properties = 0);
+
+    cl::Program loadProgram(const std::string& filename = "kernel/kernel.pz") const;
+
+    // Prints the device name and the work item count.
+    void showDeviceInfo() const;
+
+    size_t           device_id;
+    cl::Device       device;
+    cl::Context      context;
+    cl::CommandQueue queue;
+    std::string      device_name;
+    size_t           global_work_size;
+};
+}
+
+#endif
@@ -0,0 +1,59 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ */
+
+#include "pzcl_specialization.hpp"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+namespace {
+bool hasSpace(const std::string& s)
+{
+    return std::any_of(s.begin(), s.end(), [](unsigned char c) { return std::isspace(c) != 0; });
+}
+}
+
+namespace pzcl {
+KernelParams& KernelParams::define(const std::string& name, const std::string& value)
+{
+    if (name.empty() || hasSpace(name) || hasSpace(value)) {
+        throw std::invalid_argument("invalid kernel parameter: " + name + "=" + value);
+    }
+    defines[name] = value;
+    return *this;
+}
+
+std::string KernelParams::options() const
+{
+    std::string ret;
+    for (const auto& d : defines) {
+        if (!ret.empty()) {
+            ret += " ";
+        }
+        ret += "-D" + d.first + "=" + d.second;
+    }
+    return ret;
+}
+
+SpecializedProgram::SpecializedProgram(const cl::Context& context_, const cl::Device& device_, const std::string& source_, ProgramCache& cache_)
+    : context(context_)
+    , device(device_)
+    , source(source_)
+    , cache(cache_)
+{
+}
+
+cl::Program SpecializedProgram::get(const KernelParams& params)
+{
+    const std::string options = params.options();
+
+    auto it = programs.find(options);
+    if (it == programs.end()) {
+        it = programs.emplace(options, cache.build(context, device, source, options)).first;
+    }
+    return it->second;
+}
+}
@@ -0,0 +1,96 @@
+/*!
+ * @author    PEZY Computing, K.K.
+ * @date      2019
+ * @copyright BSD-3-Clause
+ * @brief     Kernels specialized with compile-time constants
+ * @details   A kernel source written against macros (element type, problem
+ *            size, unroll factor, work size, ...) is built once per set of
+ *            values, given to the compiler as -D options. With the loop
+ *            bounds and strides known, the compiler can unroll and
+ *            strength-reduce the loops. Variants are kept in memory and in
+ *            the on-disk ProgramCache.
+ */
+
+#ifndef PZCL_SPECIALIZATION_HPP
+#define PZCL_SPECIALIZATION_HPP
+
+#include "pzcl_program_cache.hpp"
+#include <map>
+#include <string>
+#include <type_traits>
+
+namespace pzcl {
+// Name of an element type in pzc source.
+template <typename T>
+struct TypeName;
+
+template <>
+struct TypeName<float> {
+    static const char* get() { return "float"; }
+};
+
+template <>
+struct TypeName<double> {
+    static const char* get() { return "double"; }
+};
+
+template <>
+struct TypeName<int> {
+    static const char* get() { return "int"; }
+};
+
+template <>
+struct TypeName<long> {
+    static const char* get() { return "long"; }
+};
+
+// Compile-time constants of one kernel variant.
+class KernelParams {
+public:
+    // Values must not contain white space.
+    KernelParams& define(const std::string& name, const std::string& value);
+    KernelParams& define(const std::string& name, const char* value)
+    {
+        return define(name, std::string(value));
+    }
+
+    template <typename T>
+    KernelParams& define(const std::string& name, T value)
+    {
+        static_assert(std::is_integral<T>::value, "use a string for non-integral values");
+        return define(name, std::to_string(value));
+    }
+
+    template <typename T>
+    KernelParams& defineType(const std::string& name)
+    {
+        return define(name, TypeName<T>::get());
+    }
+
+    // "-DNAME=value ..." in name order, so equal sets give equal options.
+    std::string options() const;
+
+private:
+    std::map<std::string, std::string> defines;
+};
+
+// Variants of one kernel source on one device.
+class SpecializedProgram {
+public:
+    SpecializedProgram(const cl::Context& context, const cl::Device& device, const std::string& source, ProgramCache& cache);
+
+    // Builds the variant for params on first use.
+    cl::Program get(const KernelParams& params);
+
+    size_t variants() const { return programs.size(); }
+
+private:
+    cl::Context                        context;
+    cl::Device                         device;
+    std::string                        source;
+    ProgramCache&                      cache;
+    std::map<std::string, cl::Program> programs;
+};
+}
+
+#endif
@@ -1,8 +1,11 @@
 #!/bin/bash
 set -eux
 
-for sample in $PWD/*/*; do
-  if [[ ${PZC_TARGET_ARCH} == "sc1-64" && $(basename $sample) == "Atomic" ]]; then
+# samples using atomic functions, which sc1/sc1-64 does not support
+ATOMIC_SAMPLES=(Atomic atomicBench work_queue)
+
+for sample in $PWD/[0-9]_*/*; do
+  if [[ ${PZC_TARGET_ARCH} == "sc1-64" && " ${ATOMIC_SAMPLES[*]} " == *" $(basename $sample) "* ]]; then
     continue
   fi
   cd $sample